@@ -31,6 +31,7 @@
 #include "../utils/NSGDist.h"
 #include "../utils/beamSearch.h"
 #include "../utils/graph.h"
+#include "../utils/medoid.h"
 #include "../utils/point_range.h"
 #include "../utils/types.h"
 #include "parlay/parallel.h"
@@ -48,7 +49,7 @@ struct knn_index {
   std::set<indexType> delete_set;
   indexType start_point;
 
-  knn_index(BuildParams &BP) : BP(BP) {}
+  knn_index(BuildParams &BP) : BP(BP), start_point(0) {}
 
   indexType get_start() { return start_point; }
 
@@ -56,7 +57,7 @@ struct knn_index {
   // that the new candidate set is added to the field new_nbhs instead
   // of directly replacing the out_nbh of p
   parlay::sequence<indexType> robustPrune(indexType p,
-                                          parlay::sequence<pid> &cand,
+                                          parlay::slice<pid *, pid *> cand,
                                           GraphI &G, PR &Points, double alpha,
                                           bool add = true) {
     // add out neighbors of p to the candidate set.
@@ -65,12 +66,11 @@ struct knn_index {
     for (auto x : cand) candidates.push_back(x);
 
     if (add) {
-      for (size_t i = 0; i < out_size; i++) {
-        // candidates.push_back(std::make_pair(v[p]->out_nbh[i],
-        // Points[v[p]->out_nbh[i]].distance(Points[p])));
-        candidates.push_back(
-            std::make_pair(G[p][i], Points[G[p][i]].distance(Points[p])));
-      }
+      std::vector<distanceType> out_dists(out_size);
+      Points.distance_batch(Points[p], G[p].begin(), out_size,
+                            out_dists.data());
+      for (size_t i = 0; i < out_size; i++)
+        candidates.push_back(std::make_pair(G[p][i], out_dists[i]));
     }
 
     // Sort the candidate set in reverse order according to distance from p.
@@ -82,6 +82,14 @@ struct knn_index {
 
     size_t candidate_idx = 0;
 
+    // the surviving candidates after p_star, and their distances to it
+    std::vector<size_t> remaining;
+    std::vector<indexType> remaining_ids;
+    std::vector<distanceType> starprime_dists;
+    remaining.reserve(candidates.size());
+    remaining_ids.reserve(candidates.size());
+    starprime_dists.resize(candidates.size());
+
     while (new_nbhs.size() < BP.R && candidate_idx < candidates.size()) {
       // Don't need to do modifications.
       int p_star = candidates[candidate_idx].first;
@@ -92,15 +100,30 @@ struct knn_index {
 
       new_nbhs.push_back(p_star);
 
+      remaining.clear();
+      remaining_ids.clear();
       for (size_t i = candidate_idx; i < candidates.size(); i++) {
         int p_prime = candidates[i].first;
         if (p_prime != -1) {
-          distanceType dist_starprime =
-              Points[p_star].distance(Points[p_prime]);
-          distanceType dist_pprime = candidates[i].second;
-          if (alpha * dist_starprime <= dist_pprime) {
-            candidates[i].first = -1;
-          }
+          remaining.push_back(i);
+          remaining_ids.push_back(p_prime);
+        }
+      }
+      // only whether alpha * dist_starprime <= dist_pprime matters, so
+      // the distances can stop early past dist_pprime / alpha, rounded up
+      for (size_t j = 0; j < remaining.size(); j++)
+        starprime_dists[j] = std::nextafter(
+            (distanceType)(candidates[remaining[j]].second / alpha),
+            std::numeric_limits<distanceType>::max());
+      Points.distance_batch_bounded(Points[p_star], remaining_ids.data(),
+                                    remaining_ids.size(),
+                                    starprime_dists.data(),
+                                    starprime_dists.data());
+      for (size_t j = 0; j < remaining.size(); j++) {
+        distanceType dist_starprime = starprime_dists[j];
+        distanceType dist_pprime = candidates[remaining[j]].second;
+        if (alpha * dist_starprime <= dist_pprime) {
+          candidates[remaining[j]].first = -1;
         }
       }
     }
@@ -109,6 +132,13 @@ struct knn_index {
     return new_neighbors_seq;
   }
 
+  parlay::sequence<indexType> robustPrune(indexType p,
+                                          parlay::sequence<pid> &cand,
+                                          GraphI &G, PR &Points, double alpha,
+                                          bool add = true) {
+    return robustPrune(p, parlay::make_slice(cand), G, Points, alpha, add);
+  }
+
   // wrapper to allow calling robustPrune on a sequence of candidates
   // that do not come with precomputed distances
   parlay::sequence<indexType> robustPrune(
@@ -116,16 +146,20 @@ struct knn_index {
       PR &Points, double alpha, bool add = true) {
     parlay::sequence<pid> cc;
     cc.reserve(candidates.size());  // + size_of(p->out_nbh));
+    std::vector<distanceType> dists(candidates.size());
+    Points.distance_batch(Points[p], candidates.begin(), candidates.size(),
+                          dists.data());
     for (size_t i = 0; i < candidates.size(); ++i) {
-      cc.push_back(std::make_pair(candidates[i],
-                                  Points[candidates[i]].distance(Points[p])));
+      cc.push_back(std::make_pair(candidates[i], dists[i]));
     }
     return robustPrune(p, cc, G, Points, alpha, add);
   }
 
   void build_index(GraphI &G, PR &Points, stats<indexType> &BuildStats) {
     std::cout << "Building graph..." << std::endl;
-    start_point = 0;
+    start_point = approximate_medoid<PR, indexType>(Points);
+    G.set_start_point(start_point);
+    std::cout << "Start point " << start_point << std::endl;
     parlay::sequence<indexType> inserts = parlay::tabulate(
         Points.size(), [&](size_t i) { return static_cast<indexType>(i); });
 
@@ -278,9 +312,11 @@ struct knn_index {
         size_t index = shuffled_inserts[i];
         QueryParams QP((long)0, BP.L, (double)0.0, (long)Points.size(),
                        (long)G.max_degree());
-        parlay::sequence<pid> visited =
-            (beam_search<Point, PointRange, indexType>(Points[index], G, Points,
-                                                       start_point, QP))
+        auto &ctx = local_search_context<indexType, distanceType>();
+        auto visited =
+            (beam_search<Point, PointRange, indexType>(
+                 Points[index], G, Points,
+                 parlay::make_slice(&start_point, &start_point + 1), QP, ctx))
                 .first.second;
         BuildStats.increment_visited(index, visited.size());
         new_out_[i - floor] = robustPrune(index, visited, G, Points, alpha);
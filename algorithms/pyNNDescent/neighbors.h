@@ -31,13 +31,21 @@
 #include "../utils/stats.h"
 #include "../utils/parse_results.h"
 #include "../utils/check_nn_recall.h"
+#include "../utils/check_filtered_recall.h"
+#include "../utils/check_range_recall.h"
 
 
-template<typename Point, typename PointRange, typename indexType>
+template<typename Point, typename PointRange, typename indexType,
+         typename QPointRange = PQPointRange<Point>>
 void ANN(Graph<indexType> &G, long k, BuildParams &BP,
          PointRange &Query_Points,
          groundTruth<indexType> GT, char *res_file,
-         bool graph_built, PointRange &Points) {
+         bool graph_built, PointRange &Points,
+         parlay::sequence<indexType> &id_map,
+         QPointRange *QPoints = nullptr,
+         RangeGroundTruth<indexType> *RGT = nullptr, double radius = 0,
+         PointLabels<indexType> *Base_Labels = nullptr,
+         PointLabels<indexType> *Query_Labels = nullptr) {
   parlay::internal::timer t("ANN"); 
   {
     using findex = pyNN_index<Point, PointRange, indexType>;
@@ -51,10 +59,23 @@ void ANN(Graph<indexType> &G, long k, BuildParams &BP,
 
     std::string name = "pyNNDescent";
     std::string params = "K = " + std::to_string(K);
+    // searches start from the router's entries if BP asks for a router
+    entry_router<indexType> router;
+    if (BP.num_entries > 0) {
+      router = entry_router<indexType>(Points, BP.num_entries, BP.entry_starts);
+      idx_time += t.next_time();
+      params += ", entries = " + std::to_string(router.size()) +
+                ", starts = " + std::to_string(router.num_starts);
+    }
     auto [avg_deg, max_deg] = graph_stats_(G);
     Graph_ G_(name, params, G.size(), avg_deg, max_deg, idx_time);
     G_.print();
-    if(Query_Points.size() != 0) search_and_parse<Point, PointRange, indexType>(G_, G, Points, Query_Points, GT, res_file, k);
+    if(Query_Points.size() != 0 && Query_Labels != nullptr)
+      filtered_search_and_parse<Point, PointRange, indexType>(G_, G, Points, Query_Points, GT, *Base_Labels, *Query_Labels, res_file, k, G.start_point(), id_map);
+    else if(Query_Points.size() != 0 && RGT != nullptr)
+      range_search_and_parse<Point, PointRange, indexType>(G_, G, Points, Query_Points, *RGT, radius, res_file, id_map);
+    else if(Query_Points.size() != 0) search_and_parse<Point, PointRange, indexType>(G_, G, Points, Query_Points, GT, res_file, k, true, G.start_point(), id_map, QPoints,
+                                                                                   BP.num_entries > 0 ? &router : nullptr, BP.interleave);
   };
 }
 
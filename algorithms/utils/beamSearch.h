@@ -23,7 +23,9 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
 #include <functional>
+#include <optional>
 #include <random>
 #include <set>
 #include <unordered_set>
@@ -35,118 +37,323 @@
 #include "types.h"
 #include "graph.h"
 #include "stats.h"
+#include "router.h"
 
 
 
-template<typename Point, typename PointRange, typename indexType>
+// Beams below this width use the lossy hash filter, which stays in
+// cache and is cheap to clear; wider beams see enough vertices that
+// collisions cause noticeable recomputation.
+constexpr long EXACT_VISITED_MIN_BEAM = 64;
+// Largest graph for which each thread keeps an epoch array (2 bytes per
+// vertex); beyond this wide beams fall back to the growable hash set.
+constexpr size_t EPOCH_VISITED_MAX_POINTS = ((size_t) 1) << 24;
+
+inline VisitedMode choose_visited_mode(QueryParams &QP, size_t n) {
+  if (QP.visited_mode != VISITED_AUTO) return QP.visited_mode;
+  if (QP.beamSize < EXACT_VISITED_MIN_BEAM) return VISITED_FILTER;
+  if (n <= EPOCH_VISITED_MAX_POINTS) return VISITED_EPOCH;
+  return VISITED_HASH;
+}
+
+// Scratch space for beam_search.  Keeping one of these per worker and
+// reusing it across queries means that, once the buffers have grown to
+// fit the largest beam seen, a search does no heap allocation.  The
+// frontier and visited views returned by beam_search point into the
+// context and are only valid until its next search.
+template<typename indexType, typename distanceType>
+struct beam_search_context {
+  using pid = std::pair<indexType, distanceType>;
+
+  // seen-vertex tracking; hash_filter backs both VISITED_FILTER and the
+  // open-addressing table of VISITED_HASH, epochs backs VISITED_EPOCH
+  VisitedMode mode = VISITED_FILTER;
+  std::vector<indexType> hash_filter;
+  size_t filter_mask = 0;
+  size_t seen_count = 0;
+  std::vector<indexType> rehash;
+  std::vector<uint16_t> epochs;
+  uint16_t epoch = 0;
+
+  std::vector<pid> frontier;
+  std::vector<pid> unvisited_frontier;
+  std::vector<pid> visited;
+  std::vector<pid> new_frontier;
+  std::vector<pid> candidates;
+  std::vector<indexType> keep;
+  std::vector<distanceType> keep_dists;
+  // the matching points of filtered_beam_search (see filtered_search.h)
+  std::vector<pid> results;
+  std::vector<pid> new_results;
+  std::vector<pid> result_candidates;
+  // whether the last search ran out of its budget (see
+  // QueryParams::max_dist_cmps and deadline_us) before it finished
+  bool truncated = false;
+
+  // prepare for a search with the given beam width and degree bound;
+  // buffers only ever grow, so steady state does not touch the allocator
+  void reset(int filter_bits, long beamSize, long max_degree,
+             VisitedMode visited_mode, size_t n) {
+    mode = visited_mode;
+    if (mode == VISITED_EPOCH) {
+      // bumping the epoch clears the set; wipe the stamps on wraparound
+      if (epochs.size() < n) {
+        epochs.assign(n, 0);
+        epoch = 0;
+      }
+      if (++epoch == 0) {
+        std::fill(epochs.begin(), epochs.end(), 0);
+        epoch = 1;
+      }
+    } else {
+      size_t filter_size = ((size_t) 1) << filter_bits;
+      if (hash_filter.size() < filter_size) hash_filter.resize(filter_size);
+      std::fill(hash_filter.begin(), hash_filter.begin() + filter_size, -1);
+      filter_mask = filter_size - 1;
+      seen_count = 0;
+    }
+    if (unvisited_frontier.size() < beamSize) unvisited_frontier.resize(beamSize);
+    if (new_frontier.size() < beamSize + max_degree)
+      new_frontier.resize(beamSize + max_degree);
+    frontier.clear();
+    frontier.reserve(beamSize);
+    visited.clear();
+    visited.reserve(2 * beamSize);
+    candidates.clear();
+    candidates.reserve(max_degree);
+    keep.clear();
+    keep.reserve(max_degree);
+    if (keep_dists.size() < max_degree) keep_dists.resize(max_degree);
+    truncated = false;
+  }
+
+  // returns true if a has been seen in this search, otherwise records it
+  bool has_been_seen(indexType a) {
+    if (mode == VISITED_EPOCH) {
+      if (epochs[a] == epoch) return true;
+      epochs[a] = epoch;
+      return false;
+    }
+    size_t loc = parlay::hash64_2(a) & filter_mask;
+    if (mode == VISITED_FILTER) {
+      // can give false negatives -- i.e. can say not in table when it is
+      if (hash_filter[loc] == a) return true;
+      hash_filter[loc] = a;
+      return false;
+    }
+    // linear probing, kept at most half full
+    while (hash_filter[loc] != (indexType) -1) {
+      if (hash_filter[loc] == a) return true;
+      loc = (loc + 1) & filter_mask;
+    }
+    hash_filter[loc] = a;
+    if (2 * (++seen_count) > filter_mask) grow_hash();
+    return false;
+  }
+
+ private:
+  void grow_hash() {
+    size_t size = filter_mask + 1;
+    rehash.clear();
+    for (size_t i = 0; i < size; i++)
+      if (hash_filter[i] != (indexType) -1) rehash.push_back(hash_filter[i]);
+    if (hash_filter.size() < 2 * size) hash_filter.resize(2 * size);
+    std::fill(hash_filter.begin(), hash_filter.begin() + 2 * size, -1);
+    filter_mask = 2 * size - 1;
+    for (indexType a : rehash) {
+      size_t loc = parlay::hash64_2(a) & filter_mask;
+      while (hash_filter[loc] != (indexType) -1) loc = (loc + 1) & filter_mask;
+      hash_filter[loc] = a;
+    }
+  }
+};
+
+// the context owned by the calling thread, shared by every search it runs
+template<typename indexType, typename distanceType>
+beam_search_context<indexType, distanceType> &local_search_context() {
+  static thread_local beam_search_context<indexType, distanceType> ctx;
+  return ctx;
+}
+
+template<typename Point, typename PointRange, typename indexType,
+         typename GraphType = Graph<indexType>>
 std::pair<std::pair<parlay::sequence<std::pair<indexType, typename Point::distanceType>>, parlay::sequence<std::pair<indexType, typename Point::distanceType>>>, indexType>
-beam_search(Point p, Graph<indexType> &G, PointRange &Points,
+beam_search(Point p, GraphType &G, PointRange &Points,
 	    indexType starting_point, QueryParams &QP) {
   
   parlay::sequence<indexType> start_points = {starting_point};
   return beam_search(p, G, Points, start_points, QP);
 }
 
-// main beam search
-template<typename Point, typename PointRange, typename indexType>
+// as below, but copies the results out of the thread's search context
+template<typename Point, typename PointRange, typename indexType,
+         typename GraphType = Graph<indexType>>
 std::pair<std::pair<parlay::sequence<std::pair<indexType, typename Point::distanceType>>, parlay::sequence<std::pair<indexType, typename Point::distanceType>>>, size_t>
-beam_search(Point p, Graph<indexType> &G, PointRange &Points,
+beam_search(Point p, GraphType &G, PointRange &Points,
 	      parlay::sequence<indexType> starting_points, QueryParams &QP) {
+  auto &ctx = local_search_context<indexType, typename Point::distanceType>();
+  auto [pairElts, dist_cmps] =
+      beam_search(p, G, Points, parlay::make_slice(starting_points), QP, ctx);
+  return std::make_pair(std::make_pair(parlay::to_sequence(pairElts.first),
+                                       parlay::to_sequence(pairElts.second)),
+                        dist_cmps);
+}
+
+// One beam search, advanced one visited vertex at a time so that a worker
+// can interleave several (see searchAllInterleaved).  Each step has three
+// phases: fetch picks the closest unvisited frontier vertex and prefetches
+// its neighbor list, expand reads the list and prefetches the neighbors not
+// seen yet, and score computes their distances and updates the frontier.
+// The frontier and visited set live in ctx.
+template<typename Point, typename PointRange, typename indexType,
+         typename GraphType = Graph<indexType>>
+struct beam_search_state {
+  using distanceType = typename Point::distanceType;
+  using pid = std::pair<indexType, distanceType>;
+
+  Point p;
+  GraphType &G;
+  PointRange &Points;
+  QueryParams &QP;
+  beam_search_context<indexType, distanceType> &ctx;
+
+  // counters
+  size_t dist_cmps;
+  int remain = 1;
+  int num_visited = 0;
+  // visits since the closest k last changed, see QP.patience
+  long stale = 0;
+  bool ratio_stop;
+  // when QP.deadline_us runs out
+  std::chrono::steady_clock::time_point deadline;
+  pid current;
 
   // compare two (node_id,distance) pairs, first by distance and then id if
   // equal
-  using distanceType = typename Point::distanceType; 
-  auto less = [&](std::pair<indexType, distanceType> a, std::pair<indexType, distanceType> b) {
+  static bool less(pid a, pid b) {
     return a.second < b.second || (a.second == b.second && a.first < b.first);
-  };
-  
+  }
 
-  // used as a hash filter (can give false negative -- i.e. can say
-  // not in table when it is)
-  int bits = std::max<int>(10, std::ceil(std::log2(QP.beamSize * QP.beamSize)) - 2);
-  std::vector<indexType> hash_filter(1 << bits, -1);
-  auto has_been_seen = [&](indexType a) -> bool {
-    int loc = parlay::hash64_2(a) & ((1 << bits) - 1);
-    if (hash_filter[loc] == a) return true;
-    hash_filter[loc] = a;
-    return false;
-  };
-
-  // Frontier maintains the closest points found so far and its size
-  // is always at most beamSize.  Each entry is a (id,distance) pair.
-  // Initialized with starting points and kept sorted by distance.
-  std::vector<std::pair<indexType, distanceType>> frontier;
-  frontier.reserve(QP.beamSize);
-  for (auto q : starting_points)
-    frontier.push_back(std::pair<indexType, distanceType>(q, Points[q].distance(p)));
-  std::sort(frontier.begin(), frontier.end(), less);
-
-  // The subset of the frontier that has not been visited
-  // Use the first of these to pick next vertex to visit.
-  std::vector<std::pair<indexType, distanceType>> unvisited_frontier(QP.beamSize);
-  unvisited_frontier[0] = frontier[0];
-
-  // maintains sorted set of visited vertices (id-distance pairs)
-  std::vector<std::pair<indexType, distanceType>> visited;
-  visited.reserve(2 * QP.beamSize);
+  beam_search_state(Point p, GraphType &G, PointRange &Points,
+                    parlay::slice<indexType*, indexType*> starting_points,
+                    QueryParams &QP,
+                    beam_search_context<indexType, distanceType> &ctx)
+      : p(p), G(G), Points(Points), QP(QP), ctx(ctx),
+        dist_cmps(starting_points.size()),
+        ratio_stop(QP.k > 0 && QP.stop_ratio > 0 && Points[0].is_metric()) {
+    // tracks the vertices already seen so their distances are not
+    // recomputed; the hash table starts with room for about beamSize^2/4
+    // entries
+    int bits = std::max<int>(10, std::ceil(std::log2(QP.beamSize * QP.beamSize)) - 2);
+    ctx.reset(bits, QP.beamSize, G.max_degree(), choose_visited_mode(QP, G.size()),
+              G.size());
+    if (QP.deadline_us > 0)
+      deadline = std::chrono::steady_clock::now() +
+                 std::chrono::microseconds(QP.deadline_us);
+
+    // Frontier maintains the closest points found so far and its size
+    // is always at most beamSize.  Each entry is a (id,distance) pair.
+    // Initialized with starting points and kept sorted by distance.
+    for (auto q : starting_points) {
+      ctx.has_been_seen(q);
+      ctx.frontier.push_back(pid(q, Points[q].distance(p)));
+    }
+    std::sort(ctx.frontier.begin(), ctx.frontier.end(), less);
 
-  // counters
-  size_t dist_cmps = starting_points.size();
-  int remain = 1;
-  int num_visited = 0;
-  double total;
+    // The subset of the frontier that has not been visited
+    // Use the first of these to pick next vertex to visit.
+    ctx.unvisited_frontier[0] = ctx.frontier[0];
+  }
 
-  // used as temporaries in the loop
-  std::vector<std::pair<indexType, distanceType>> new_frontier(QP.beamSize + G.max_degree());
-  std::vector<std::pair<indexType, distanceType>> candidates;
-  candidates.reserve(G.max_degree());
-  std::vector<indexType> keep;
-  keep.reserve(G.max_degree());
-
-  // The main loop.  Terminate beam search when the entire frontier
-  // has been visited or have reached max_visit.
-  while (remain > 0 && num_visited < QP.limit) {
-    // the next node to visit is the unvisited frontier node that is closest to
-    // p
-    std::pair<indexType, distanceType> current = unvisited_frontier[0];
+  // Terminate beam search when the entire frontier has been visited or
+  // have reached max_visit, or early if the closest k have settled (see
+  // QP.patience and QP.stop_ratio).  A search that runs out of its budget
+  // is marked as truncated; the clock is only read every few visits, and
+  // the first visit always happens so the beam holds more than the start.
+  bool active() {
+    if (remain == 0 || num_visited >= QP.limit) return false;
+    if (num_visited > 0 &&
+        ((QP.max_dist_cmps > 0 && dist_cmps >= QP.max_dist_cmps) ||
+         (QP.deadline_us > 0 && num_visited % 4 == 0 &&
+          std::chrono::steady_clock::now() >= deadline))) {
+      ctx.truncated = true;
+      return false;
+    }
+    if (QP.patience > 0 && stale >= QP.patience) return false;
+    if (ratio_stop && ctx.frontier.size() >= QP.k &&
+        ctx.unvisited_frontier[0].second >
+            QP.stop_ratio * ctx.frontier[QP.k - 1].second)
+      return false;
+    return true;
+  }
+
+  void fetch() {
+    // the next node to visit is the unvisited frontier node that is
+    // closest to p
+    current = ctx.unvisited_frontier[0];
     G[current.first].prefetch();
-    // add to visited set
-    visited.insert(
-        std::upper_bound(visited.begin(), visited.end(), current, less),
+    // add to visited set, a sorted set of id-distance pairs
+    ctx.visited.insert(
+        std::upper_bound(ctx.visited.begin(), ctx.visited.end(), current, less),
         current);
     num_visited++;
+  }
 
-    // keep neighbors that have not been visited (using approximate
-    // hash). Note that if a visited node is accidentally kept due to
-    // approximate hash it will be removed below by the union or will
-    // not bump anyone else.
-    candidates.clear();
-    keep.clear();
+  void expand() {
+    // keep neighbors that have not been seen. Note that if the lossy
+    // filter accidentally keeps a visited node it will be removed below
+    // by the union or will not bump anyone else.
+    ctx.candidates.clear();
+    ctx.keep.clear();
     long num_elts = std::min<long>(G[current.first].size(), QP.degree_limit);
     for (indexType i=0; i<num_elts; i++) {
       auto a = G[current.first][i];
-      if (a == p.id() || has_been_seen(a)) continue;  // skip if already seen
-      keep.push_back(a);
+      if (a == p.id() || ctx.has_been_seen(a)) continue;  // skip if already seen
+      ctx.keep.push_back(a);
       Points[a].prefetch();
     }
+  }
 
-    // Further filter on whether distance is greater than current
-    // furthest distance in current frontier (if full).
+  void score() {
+    std::vector<pid> &frontier = ctx.frontier;
+    std::vector<pid> &new_frontier = ctx.new_frontier;
+    std::vector<pid> &candidates = ctx.candidates;
+    std::vector<indexType> &keep = ctx.keep;
+    std::vector<distanceType> &keep_dists = ctx.keep_dists;
+
+    // compute the distances to all kept neighbors in one pass, then
+    // filter on whether distance is greater than current furthest
+    // distance in current frontier (if full).  Once it is full the
+    // distances past it are discarded, so they can stop early.
     distanceType cutoff = ((frontier.size() < QP.beamSize)
                            ? (distanceType)std::numeric_limits<int>::max()
                            : frontier[frontier.size() - 1].second);
-    for (auto a : keep) {
-      distanceType dist = Points[a].distance(p);
-      total += dist;
-      dist_cmps++;
+    if (frontier.size() < QP.beamSize) {
+      Points.distance_batch(p, keep.data(), keep.size(), keep_dists.data());
+    } else {
+      std::fill(keep_dists.begin(), keep_dists.begin() + keep.size(), cutoff);
+      Points.distance_batch_bounded(p, keep.data(), keep.size(),
+                                    keep_dists.data(), keep_dists.data());
+    }
+    dist_cmps += keep.size();
+    for (size_t j = 0; j < keep.size(); j++) {
       // skip if frontier not full and distance too large
-      if (dist >= cutoff) continue;
-      candidates.push_back(std::pair{a, dist});
+      if (keep_dists[j] >= cutoff) continue;
+      candidates.push_back(std::pair{keep[j], keep_dists[j]});
     }
 
     // sort the candidates by distance from p
     std::sort(candidates.begin(), candidates.end(), less);
 
+    // the closest k change if the closest candidate enters them
+    if (QP.patience > 0 && QP.k > 0) {
+      if (frontier.size() < QP.k ||
+          (!candidates.empty() && less(candidates[0], frontier[QP.k - 1])))
+        stale = 0;
+      else
+        stale++;
+    }
+
     // union the frontier and candidates into new_frontier, both are sorted
     auto new_frontier_size =
         std::set_union(frontier.begin(), frontier.end(), candidates.begin(),
@@ -173,14 +380,38 @@ beam_search(Point p, Graph<indexType> &G, PointRange &Points,
 
     // get the unvisited frontier (we only care about the first one)
     remain =
-        std::set_difference(frontier.begin(), frontier.end(), visited.begin(),
-                            visited.end(), unvisited_frontier.begin(), less) -
-        unvisited_frontier.begin();
+        std::set_difference(frontier.begin(), frontier.end(), ctx.visited.begin(),
+                            ctx.visited.end(), ctx.unvisited_frontier.begin(), less) -
+        ctx.unvisited_frontier.begin();
   }
 
-  return std::make_pair(std::make_pair(parlay::to_sequence(frontier),
-                                       parlay::to_sequence(visited)),
-                        dist_cmps);
+  // views of the frontier and the visited set, and the number of distance
+  // comparisons
+  auto result() {
+    return std::make_pair(
+        std::make_pair(parlay::make_slice(ctx.frontier.data(), ctx.frontier.data() + ctx.frontier.size()),
+                       parlay::make_slice(ctx.visited.data(), ctx.visited.data() + ctx.visited.size())),
+        dist_cmps);
+  }
+};
+
+// main beam search; returns views of the frontier and the visited set
+// that live in ctx.  G may be a Graph or any type with the same size,
+// max_degree and operator[] returning an edgeRange, such as the graph view
+// of a node_store (see node_store.h).
+template<typename Point, typename PointRange, typename indexType,
+         typename GraphType = Graph<indexType>>
+auto beam_search(Point p, GraphType &G, PointRange &Points,
+                 parlay::slice<indexType*, indexType*> starting_points, QueryParams &QP,
+                 beam_search_context<indexType, typename Point::distanceType> &ctx) {
+  beam_search_state<Point, PointRange, indexType, GraphType> S(
+      p, G, Points, starting_points, QP, ctx);
+  while (S.active()) {
+    S.fetch();
+    S.expand();
+    S.score();
+  }
+  return S.result();
 }
 
 // // has same functionality as above but written differently (taken from HNSW)
@@ -270,6 +501,92 @@ beam_search(Point p, Graph<indexType> &G, PointRange &Points,
 //       dist_cmps);
 // }
 
+// the contexts owned by the calling thread for searches it interleaves
+template<typename indexType, typename distanceType>
+std::vector<beam_search_context<indexType, distanceType>> &local_search_contexts(size_t count) {
+  static thread_local std::vector<beam_search_context<indexType, distanceType>> ctxs;
+  if (ctxs.size() < count) ctxs.resize(count);
+  return ctxs;
+}
+
+// As searchAll, but each worker keeps QP.interleave queries in flight and
+// advances them round robin (see beam_search_state): all of them expand
+// the vertex they fetched, then each scores its neighbors and fetches its
+// next vertex, so the prefetches one search issues are served while the
+// others compute.  Each task runs a block of queries, refilling a slot as
+// soon as its query finishes.  starts(i) gives the start points of query
+// i.  The results are the same as searchAll's, but the exact visited sets
+// are hash tables, since an epoch array per slot would crowd the cache.
+template<typename Point, typename PointRange, typename indexType, typename StartFn>
+parlay::sequence<parlay::sequence<indexType>> searchAllInterleaved(PointRange &Query_Points,
+                                        Graph<indexType> &G, PointRange &Base_Points, stats<indexType> &QueryStats,
+                                        StartFn starts, QueryParams &QP) {
+  using distanceType = typename Point::distanceType;
+  using state = beam_search_state<Point, PointRange, indexType>;
+  QueryParams IQ = QP;
+  if (choose_visited_mode(QP, G.size()) == VISITED_EPOCH) IQ.visited_mode = VISITED_HASH;
+  size_t n = Query_Points.size();
+  size_t group = QP.interleave;
+  size_t block = 8 * group;
+  size_t num_blocks = (n + block - 1) / block;
+  parlay::sequence<parlay::sequence<indexType>> all_neighbors(n);
+  parlay::parallel_for(0, num_blocks, [&](size_t b) {
+    auto &ctxs = local_search_contexts<indexType, distanceType>(group);
+    std::vector<std::optional<state>> slots(group);
+    std::vector<size_t> ids(group);
+    size_t next = b * block;
+    size_t end = std::min(n, (b + 1) * block);
+
+    auto finish = [&](size_t s) {
+      auto [pairElts, dist_cmps] = slots[s]->result();
+      auto [beamElts, visitedElts] = pairElts;
+      parlay::sequence<indexType> neighbors(QP.k, (indexType)-1);
+      for (size_t j = 0; j < std::min<size_t>(QP.k, beamElts.size()); j++)
+        neighbors[j] = beamElts[j].first;
+      all_neighbors[ids[s]] = neighbors;
+      QueryStats.increment_visited(ids[s], visitedElts.size());
+      QueryStats.increment_dist(ids[s], dist_cmps);
+      if (ctxs[s].truncated) QueryStats.set_truncated(ids[s]);
+      slots[s].reset();
+    };
+    // starts the next query of the block in slot s, if any is left, and
+    // fetches its first vertex
+    auto refill = [&](size_t s) {
+      while (next < end && !slots[s]) {
+        size_t i = next++;
+        parlay::sequence<indexType> start_points = starts(i);
+        ids[s] = i;
+        slots[s].emplace(Query_Points[i], G, Base_Points,
+                         parlay::make_slice(start_points), IQ, ctxs[s]);
+        if (slots[s]->active()) slots[s]->fetch();
+        else finish(s);
+      }
+    };
+
+    for (size_t s = 0; s < group; s++) refill(s);
+    while (true) {
+      bool any = false;
+      for (auto &S : slots)
+        if (S) {
+          S->expand();
+          any = true;
+        }
+      if (!any) break;
+      for (size_t s = 0; s < group; s++) {
+        if (!slots[s]) continue;
+        slots[s]->score();
+        if (slots[s]->active()) {
+          slots[s]->fetch();
+        } else {
+          finish(s);
+          refill(s);
+        }
+      }
+    }
+  }, 1);
+  return all_neighbors;
+}
+
 // searches every element in q starting from a randomly selected point
 template<typename Point, typename PointRange, typename indexType>
 parlay::sequence<parlay::sequence<indexType>> beamSearchRandom(PointRange& Query_Points,
@@ -292,21 +609,24 @@ parlay::sequence<parlay::sequence<indexType>> beamSearchRandom(PointRange& Query
     return dis(r);
   });
 
+  if (QP.interleave > 1)
+    return searchAllInterleaved<Point, PointRange, indexType>(
+        Query_Points, G, Base_Points, QueryStats,
+        [&](size_t i) { return parlay::sequence<indexType>(1, indices[i]); }, QP);
   parlay::parallel_for(0, Query_Points.size(), [&](size_t i) {
-    parlay::sequence<indexType> neighbors = parlay::sequence<indexType>(QP.k);
+    auto &ctx = local_search_context<indexType, typename Point::distanceType>();
+    parlay::sequence<indexType> neighbors(QP.k, (indexType)-1);
     indexType start = indices[i];
-    parlay::sequence<std::pair<indexType, typename Point::distanceType>> beamElts;
-    parlay::sequence<std::pair<indexType, typename Point::distanceType>> visitedElts;
-    auto [pairElts, dist_cmps] = 
-        beam_search(Query_Points[i], G, Base_Points, start, QP);
-    beamElts = pairElts.first;
-    visitedElts = pairElts.second;
-    for (indexType j = 0; j < QP.k; j++) {
+    auto [pairElts, dist_cmps] = beam_search(
+        Query_Points[i], G, Base_Points, parlay::make_slice(&start, &start + 1), QP, ctx);
+    auto [beamElts, visitedElts] = pairElts;
+    for (size_t j = 0; j < std::min<size_t>(QP.k, beamElts.size()); j++) {
       neighbors[j] = beamElts[j].first;
     }
     all_neighbors[i] = neighbors;
     QueryStats.increment_visited(i, visitedElts.size());
     QueryStats.increment_dist(i, dist_cmps);
+    if (ctx.truncated) QueryStats.set_truncated(i);
   });
   return all_neighbors;
 }
@@ -319,27 +639,49 @@ parlay::sequence<parlay::sequence<indexType>> searchAll(PointRange& Query_Points
     return searchAll<Point, PointRange, indexType>(Query_Points, G, Base_Points, QueryStats, start_points, QP);
 }
 
+// With a router each query starts from its closest entries instead of
+// starting_points, and the distances to the entries count as comparisons.
 template<typename Point, typename PointRange, typename indexType>
 parlay::sequence<parlay::sequence<indexType>> searchAll(PointRange &Query_Points,
 	                                       Graph<indexType> &G, PointRange &Base_Points, stats<indexType> &QueryStats, 
                                         parlay::sequence<indexType> starting_points,
-	                                      QueryParams &QP) {
+	                                      QueryParams &QP,
+                                        entry_router<indexType> *router = nullptr) {
   if (QP.k > QP.beamSize) {
     std::cout << "Error: beam search parameter Q = " << QP.beamSize
               << " same size or smaller than k = " << QP.k << std::endl;
     abort();
   }
+  if (QP.interleave > 1) {
+    auto all_neighbors = searchAllInterleaved<Point, PointRange, indexType>(
+        Query_Points, G, Base_Points, QueryStats, [&](size_t i) {
+          if (router == nullptr) return starting_points;
+          return router->route(Query_Points[i], Base_Points, QP.beamSize);
+        }, QP);
+    if (router != nullptr)
+      parlay::parallel_for(0, Query_Points.size(), [&](size_t i) {
+        QueryStats.increment_dist(i, router->size());
+      });
+    return all_neighbors;
+  }
   parlay::sequence<parlay::sequence<indexType>> all_neighbors(Query_Points.size());
   parlay::parallel_for(0, Query_Points.size(), [&](size_t i) {
-    parlay::sequence<indexType> neighbors = parlay::sequence<indexType>(QP.k);
-    auto [pairElts, dist_cmps] = beam_search(Query_Points[i], G, Base_Points, starting_points, QP);
+    auto &ctx = local_search_context<indexType, typename Point::distanceType>();
+    parlay::sequence<indexType> neighbors(QP.k, (indexType)-1);
+    parlay::sequence<indexType> routed;
+    if (router != nullptr)
+      routed = router->route(Query_Points[i], Base_Points, QP.beamSize);
+    auto starts = parlay::make_slice(router != nullptr ? routed : starting_points);
+    auto [pairElts, dist_cmps] = beam_search(
+        Query_Points[i], G, Base_Points, starts, QP, ctx);
     auto [beamElts, visitedElts] = pairElts;
-    for (indexType j = 0; j < QP.k; j++) {
+    for (size_t j = 0; j < std::min<size_t>(QP.k, beamElts.size()); j++) {
       neighbors[j] = beamElts[j].first;
     }
     all_neighbors[i] = neighbors;
     QueryStats.increment_visited(i, visitedElts.size());
-    QueryStats.increment_dist(i, dist_cmps);
+    QueryStats.increment_dist(i, dist_cmps + (router != nullptr ? router->size() : 0));
+    if (ctx.truncated) QueryStats.set_truncated(i);
   });
 
   return all_neighbors;
@@ -348,3 +690,63 @@ parlay::sequence<parlay::sequence<indexType>> searchAll(PointRange &Query_Points
 
 
 
+// Re-ranks the closest max(rerank_k, k) entries of a beam by their exact
+// distances from q in Base_Points, and returns the closest k of them with
+// their exact distances.
+template<typename Point, typename PointRange, typename indexType, typename beamType>
+parlay::sequence<std::pair<indexType, typename Point::distanceType>> rerank(
+    Point q, PointRange &Base_Points, beamType &beam, long k, long rerank_k) {
+  using distanceType = typename Point::distanceType;
+  size_t m = std::min<size_t>(beam.size(), std::max(rerank_k, k));
+  parlay::sequence<indexType> ids(m);
+  parlay::sequence<distanceType> dists(m);
+  for (size_t j = 0; j < m; j++) ids[j] = beam[j].first;
+  Base_Points.distance_batch(q, ids.begin(), m, dists.begin());
+  auto exact = parlay::tabulate(m, [&](size_t j) { return std::make_pair(ids[j], dists[j]); });
+  std::sort(exact.begin(), exact.end(), [](auto a, auto b) {
+    return a.second < b.second || (a.second == b.second && a.first < b.first);
+  });
+  exact.resize(std::min<size_t>(m, k));
+  return exact;
+}
+
+// Two stage search.  The beam runs on QPoints, a compact encoding of
+// Base_Points such as a PQPointRange, searched with the query point that
+// QPoints.query makes from the full precision query.  The closest
+// QP.rerank_k entries of the final beam are then re-ranked with exact
+// distances in Base_Points, see rerank.  A router routes the query on
+// QPoints, as in searchAll.
+template<typename Point, typename PointRange, typename QPointRange, typename indexType>
+parlay::sequence<parlay::sequence<indexType>> searchAllReranked(PointRange &Query_Points,
+                                        Graph<indexType> &G, PointRange &Base_Points, QPointRange &QPoints,
+                                        stats<indexType> &QueryStats,
+                                        parlay::sequence<indexType> starting_points,
+                                        QueryParams &QP,
+                                        entry_router<indexType> *router = nullptr) {
+  if (QP.k > QP.beamSize) {
+    std::cout << "Error: beam search parameter Q = " << QP.beamSize
+              << " same size or smaller than k = " << QP.k << std::endl;
+    abort();
+  }
+  using QPoint = typename QPointRange::Point;
+  parlay::sequence<parlay::sequence<indexType>> all_neighbors(Query_Points.size());
+  parlay::parallel_for(0, Query_Points.size(), [&](size_t i) {
+    auto &ctx = local_search_context<indexType, typename QPoint::distanceType>();
+    QPoint q = QPoints.query(Query_Points[i]);
+    parlay::sequence<indexType> routed;
+    if (router != nullptr) routed = router->route(q, QPoints, QP.beamSize);
+    auto starts = parlay::make_slice(router != nullptr ? routed : starting_points);
+    auto [pairElts, dist_cmps] = beam_search(q, G, QPoints, starts, QP, ctx);
+    auto [beamElts, visitedElts] = pairElts;
+    auto exact = rerank<Point, PointRange, indexType>(Query_Points[i], Base_Points, beamElts,
+                                                      QP.k, QP.rerank_k);
+    parlay::sequence<indexType> neighbors(QP.k, (indexType)-1);
+    for (size_t j = 0; j < exact.size(); j++) neighbors[j] = exact[j].first;
+    all_neighbors[i] = neighbors;
+    QueryStats.increment_visited(i, visitedElts.size());
+    QueryStats.increment_dist(i, dist_cmps + std::min<size_t>(beamElts.size(), std::max(QP.rerank_k, QP.k)) +
+                                     (router != nullptr ? router->size() : 0));
+    if (ctx.truncated) QueryStats.set_truncated(i);
+  });
+  return all_neighbors;
+}
@@ -0,0 +1,123 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "check_nn_recall.h"
+#include "filtered_search.h"
+#include "labels.h"
+#include "parse_results.h"
+#include "stats.h"
+#include "types.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+
+// Recall of filtered searches (see searchAllFiltered) against ground
+// truth computed over the matching points only, such as that written by
+// compute_groundtruth with -base_labels and -query_labels.  The results of
+// a reordered graph are translated with id_map before they are scored.
+template<typename Point, typename PointRange, typename indexType>
+nn_result checkFilteredRecall(Graph<indexType> &G, PointRange &Base_Points,
+                              PointRange &Query_Points,
+                              groundTruth<indexType> GT,
+                              PointLabels<indexType> &Base_Labels,
+                              PointLabels<indexType> &Query_Labels,
+                              parlay::sequence<indexType> &label_starts,
+                              indexType start_point, long k, QueryParams &QP,
+                              bool only_matching,
+                              parlay::sequence<indexType> &id_map) {
+  if (GT.size() > 0 && k > GT.dimension()) {
+    std::cout << k << "@" << k << " too large for ground truth data of size "
+              << GT.dimension() << std::endl;
+    abort();
+  }
+  parlay::internal::timer t;
+  stats<indexType> QueryStats(Query_Points.size());
+  auto all_ngh = searchAllFiltered<Point, PointRange, indexType>(
+      Query_Points, G, Base_Points, QueryStats, Base_Labels, Query_Labels,
+      label_starts, start_point, QP, only_matching);
+  t.next_time();
+  QueryStats.clear();
+  all_ngh = searchAllFiltered<Point, PointRange, indexType>(
+      Query_Points, G, Base_Points, QueryStats, Base_Labels, Query_Labels,
+      label_starts, start_point, QP, only_matching);
+  float query_time = t.next_time();
+  if (id_map.size() > 0) to_original_ids(all_ngh, id_map);
+
+  float recall = knn_recall(all_ngh, GT, k);
+  float QPS = Query_Points.size() / query_time;
+  auto stats_ = {QueryStats.dist_stats(), QueryStats.visited_stats()};
+  parlay::sequence<indexType> stats = parlay::flatten(stats_);
+  nn_result N(recall, stats, QPS, k, QP.beamSize, QP.cut,
+              Query_Points.size(), QP.limit, QP.degree_limit, k);
+  N.filter = only_matching ? "matching" : "all";
+  return N;
+}
+
+// Sweeps the beam width of filtered searches for k neighbors, as
+// search_and_parse does for unfiltered ones, both traversing every point
+// and only the matching ones, which is the faster on graphs built for
+// filters and fails on others.
+template<typename Point, typename PointRange, typename indexType>
+void filtered_search_and_parse(Graph_ G_, Graph<indexType> &G,
+                               PointRange &Base_Points, PointRange &Query_Points,
+                               groundTruth<indexType> GT,
+                               PointLabels<indexType> &Base_Labels,
+                               PointLabels<indexType> &Query_Labels,
+                               char *res_file, long k, indexType start_point,
+                               parlay::sequence<indexType> &id_map) {
+  if (Base_Labels.size() != Base_Points.size() ||
+      Query_Labels.size() != Query_Points.size()) {
+    std::cout << "ERROR: " << Base_Labels.size() << " base and "
+              << Query_Labels.size() << " query labels for "
+              << Base_Points.size() << " base and " << Query_Points.size()
+              << " query points" << std::endl;
+    abort();
+  }
+  if (k == 0) k = 10;
+  auto label_starts =
+      label_start_points<PointRange, indexType>(Base_Labels, Base_Points, start_point);
+  std::cout << "Filtered search with " << label_starts.size() << " labels" << std::endl;
+
+  parlay::sequence<nn_result> results;
+  QueryParams QP(k, k, 1.35, (long) G.size(), (long) G.max_degree());
+  std::vector<long> beams = {10, 12, 14, 16, 18, 20, 25, 30, 35, 40, 45, 50,
+                             60, 70, 80, 90, 100, 120, 140, 160, 180, 200,
+                             250, 300, 375, 500, 750, 1000};
+  for (bool only_matching : {false, true}) {
+    for (long Q : beams) {
+      if (Q < k) continue;
+      QP.beamSize = Q;
+      results.push_back(checkFilteredRecall<Point, PointRange, indexType>(
+          G, Base_Points, Query_Points, GT, Base_Labels, Query_Labels,
+          label_starts, start_point, k, QP, only_matching, id_map));
+    }
+  }
+
+  parlay::sequence<float> buckets = {.1, .2, .3, .4, .5, .6, .7, .75, .8, .85,
+                                     .9, .93, .95, .97, .98, .99, .995, .999,
+                                     .9995, .9999, .99995, .99999};
+  auto [res, ret_buckets] = parse_result(results, buckets);
+  std::cout << std::endl;
+  if (res_file != NULL)
+    write_to_csv(std::string(res_file), ret_buckets, res, G_);
+}
@@ -20,57 +20,31 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#pragma once
+
 #include <algorithm>
 #include <set>
 
 #include "beamSearch.h"
 #include "csvfile.h"
 #include "parse_results.h"
+#include "pq_point.h"
+#include "reorder.h"
 #include "parlay/parallel.h"
 #include "parlay/primitives.h"
 #include "types.h"
 #include "stats.h"
 
-template<typename Point, typename PointRange, typename indexType>
-nn_result checkRecall(
-        Graph<indexType> &G,
-        PointRange &Base_Points,
-        PointRange &Query_Points,
-        groundTruth<indexType> GT,
-        bool random,
-        long start_point, 
-        long k,
-        QueryParams &QP) {
-  if (GT.size() > 0 && k > GT.dimension()) {
-    std::cout << k << "@" << k << " too large for ground truth data of size "
-              << GT.dimension() << std::endl;
-    abort();
-  }
-
-  parlay::sequence<parlay::sequence<indexType>> all_ngh;
-
-  parlay::internal::timer t;
-  float query_time;
-  stats<indexType> QueryStats(Query_Points.size());
-  if(random){
-    all_ngh = beamSearchRandom<Point, PointRange, indexType>(Query_Points, G, Base_Points, QueryStats, QP);
-    t.next_time();
-    QueryStats.clear();
-    all_ngh = beamSearchRandom<Point, PointRange, indexType>(Query_Points, G, Base_Points, QueryStats, QP);
-    query_time = t.next_time();
-  }else{
-    all_ngh = searchAll<Point, PointRange, indexType>(Query_Points, G, Base_Points, QueryStats, start_point, QP);
-    t.next_time();
-    QueryStats.clear();
-    all_ngh = searchAll<Point, PointRange, indexType>(Query_Points, G, Base_Points, QueryStats, start_point, QP);
-    query_time = t.next_time();
-  }
-
+// The fraction of the k nearest neighbors in GT found in all_ngh, where a
+// point at the same distance as the k-th counts as one of them.
+template<typename indexType>
+float knn_recall(parlay::sequence<parlay::sequence<indexType>> &all_ngh,
+                 groundTruth<indexType> &GT, long k) {
   float recall = 0.0;
   //TODO deprecate this after further testing
   bool dists_present = true;
   if (GT.size() > 0 && !dists_present) {
-    size_t n = Query_Points.size();
+    size_t n = all_ngh.size();
     int numCorrect = 0;
     for (indexType i = 0; i < n; i++) {
       std::set<indexType> reported_nbhs;
@@ -84,7 +58,7 @@ nn_result checkRecall(
     }
     recall = static_cast<float>(numCorrect) / static_cast<float>(k * n);
   } else if (GT.size() > 0 && dists_present) {
-    size_t n = Query_Points.size();
+    size_t n = all_ngh.size();
     
     int numCorrect = 0;
     for (indexType i = 0; i < n; i++) {
@@ -107,10 +81,72 @@ nn_result checkRecall(
     }
     recall = static_cast<float>(numCorrect) / static_cast<float>(k * n);
   }
+  return recall;
+}
+
+// With QPoints the search traverses the quantized points and re-ranks
+// QP.rerank_k results with exact distances (see searchAllReranked), always
+// starting from start_point.  With a router, each query instead starts
+// from its closest router entries (see entry_router), also when random.
+template<typename Point, typename PointRange, typename indexType,
+         typename QPointRange = PQPointRange<Point>>
+nn_result checkRecall(
+        Graph<indexType> &G,
+        PointRange &Base_Points,
+        PointRange &Query_Points,
+        groundTruth<indexType> GT,
+        bool random,
+        long start_point, 
+        long k,
+        QueryParams &QP,
+        const parlay::sequence<indexType> &id_map = {},
+        QPointRange *QPoints = nullptr,
+        entry_router<indexType> *router = nullptr) {
+  if (GT.size() > 0 && k > GT.dimension()) {
+    std::cout << k << "@" << k << " too large for ground truth data of size "
+              << GT.dimension() << std::endl;
+    abort();
+  }
+
+  parlay::sequence<parlay::sequence<indexType>> all_ngh;
+
+  parlay::internal::timer t;
+  float query_time;
+  stats<indexType> QueryStats(Query_Points.size());
+  parlay::sequence<indexType> start_points = {static_cast<indexType>(start_point)};
+  if(QPoints != nullptr){
+    all_ngh = searchAllReranked<Point, PointRange, QPointRange, indexType>(Query_Points, G, Base_Points, *QPoints, QueryStats, start_points, QP, router);
+    t.next_time();
+    QueryStats.clear();
+    all_ngh = searchAllReranked<Point, PointRange, QPointRange, indexType>(Query_Points, G, Base_Points, *QPoints, QueryStats, start_points, QP, router);
+    query_time = t.next_time();
+  }else if(random && router == nullptr){
+    all_ngh = beamSearchRandom<Point, PointRange, indexType>(Query_Points, G, Base_Points, QueryStats, QP);
+    t.next_time();
+    QueryStats.clear();
+    all_ngh = beamSearchRandom<Point, PointRange, indexType>(Query_Points, G, Base_Points, QueryStats, QP);
+    query_time = t.next_time();
+  }else{
+    all_ngh = searchAll<Point, PointRange, indexType>(Query_Points, G, Base_Points, QueryStats, start_points, QP, router);
+    t.next_time();
+    QueryStats.clear();
+    all_ngh = searchAll<Point, PointRange, indexType>(Query_Points, G, Base_Points, QueryStats, start_points, QP, router);
+    query_time = t.next_time();
+  }
+  // results on a reordered graph are compared in the original ids
+  if (id_map.size() > 0) to_original_ids(all_ngh, id_map);
+
+  float recall = knn_recall(all_ngh, GT, k);
   float QPS = Query_Points.size() / query_time;
   auto stats_ = {QueryStats.dist_stats(), QueryStats.visited_stats()};
   parlay::sequence<indexType> stats = parlay::flatten(stats_);
   nn_result N(recall, stats, QPS, k, QP.beamSize, QP.cut, Query_Points.size(), QP.limit, QP.degree_limit, k);
+  if (QPoints != nullptr) N.rerank_k = std::max(QP.rerank_k, k);
+  N.patience = QP.patience;
+  N.stop_ratio = QP.stop_ratio;
+  N.max_dist_cmps = QP.max_dist_cmps;
+  N.deadline_us = QP.deadline_us;
+  N.truncated = QueryStats.num_truncated();
   return N;
 }
 
@@ -136,12 +172,19 @@ void write_to_csv(std::string csv_filename, parlay::sequence<float> buckets,
       << "Tail Visited"
       << "k"
       << "Q"
-      << "cut" << endrow;
+      << "cut"
+      << "rerank"
+      << "patience"
+      << "stop ratio"
+      << "cmps budget"
+      << "deadline (us)"
+      << "truncated" << endrow;
   for (int i = 0; i < results.size(); i++) {
     nn_result N = results[i];
     csv << N.num_queries << buckets[i] << N.recall << N.QPS << N.avg_cmps
         << N.tail_cmps << N.avg_visited << N.tail_visited << N.k << N.beamQ
-        << N.cut << endrow;
+        << N.cut << N.rerank_k << N.patience << N.stop_ratio
+        << N.max_dist_cmps << N.deadline_us << N.truncated << endrow;
   }
   csv << endrow;
   csv << endrow;
@@ -156,11 +199,20 @@ parlay::sequence<long> calculate_limits(size_t upper_bound) {
   return limits;
 }
 
-template<typename Point, typename PointRange, typename indexType>
+// With QPoints every beam width is also searched with several re-rank
+// depths, and with a router every search starts from the router's entries,
+// see checkRecall.  With interleave > 1 the searches without quantization
+// interleave that many queries per worker (see searchAllInterleaved).
+template<typename Point, typename PointRange, typename indexType,
+         typename QPointRange = PQPointRange<Point>>
 void search_and_parse(Graph_ G_, Graph<indexType> &G, PointRange &Base_Points,
    PointRange &Query_Points, 
   groundTruth<indexType> GT, char* res_file, long k,
-  bool random=true, indexType start_point=0){
+  bool random=true, indexType start_point=0,
+  const parlay::sequence<indexType> &id_map = {},
+  QPointRange *QPoints = nullptr,
+  entry_router<indexType> *router = nullptr,
+  long interleave = 0){
 
   parlay::sequence<nn_result> results;
   std::vector<long> beams;
@@ -170,6 +222,7 @@ void search_and_parse(Graph_ G_, Graph<indexType> &G, PointRange &Base_Points,
   QueryParams QP;
   QP.limit = (long) G.size();
   QP.degree_limit = (long) G.max_degree();
+  QP.interleave = interleave;
   beams = {10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 22, 24, 26, 28, 30, 32, 
           34, 36, 38, 40, 45, 50, 55, 60, 65, 70, 80, 90, 100, 120, 140, 160, 
           180, 200, 225, 250, 275, 300, 375, 500, 750, 1000}; 
@@ -185,26 +238,68 @@ void search_and_parse(Graph_ G_, Graph<indexType> &G, PointRange &Base_Points,
         for (float Q : beams){
           QP.beamSize = Q;
           if (Q > r){
-            results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP));
+            results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP, id_map, QPoints, router));
+            if (QPoints == nullptr) continue;
+            for (long rerank : {2 * r, 5 * r, 10 * r}){
+              if (rerank > Q) break;
+              QP.rerank_k = rerank;
+              results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP, id_map, QPoints, router));
+            }
+            QP.rerank_k = 0;
           }
         }
+        // adaptive termination on a coarser set of beams: wide beams that
+        // easy queries can leave early
+        for (long Q : {20, 30, 50, 100, 200, 500, 1000}){
+          if (Q <= r) continue;
+          QP.beamSize = Q;
+          for (long patience : {2 * r, 4 * r, 6 * r}){
+            QP.patience = patience;
+            results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP, id_map, QPoints, router));
+          }
+          QP.patience = 0;
+          if (!Base_Points[0].is_metric()) continue;
+          for (double ratio : {1.15, 1.25}){
+            QP.stop_ratio = ratio;
+            results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP, id_map, QPoints, router));
+          }
+          QP.stop_ratio = 0;
+        }
       }
       // check "limited accuracy"
       parlay::sequence<long> limits = calculate_limits(results[0].avg_visited);
       parlay::sequence<long> degree_limits = calculate_limits(G.max_degree());
       degree_limits.push_back(G.max_degree());
       QP = QueryParams(r, r, 1.35, (long) G.size(), (long) G.max_degree());
+      QP.interleave = interleave;
       for(long l : limits){
         QP.limit = l;
         QP.beamSize = std::max<long>(l, r);
         for(long dl : degree_limits){
           QP.degree_limit = dl;
-	        results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP));
+	        results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP, id_map, QPoints, router));
+        }
+      }
+      // check budgets: wide beams with the distance comparisons of each
+      // query capped between the average and the tail of the uncapped
+      // search, which bounds the cost of the hardest queries
+      QP = QueryParams(r, r, 1.35, (long) G.size(), (long) G.max_degree());
+      QP.interleave = interleave;
+      for (long Q : {100, 300}){
+        if (Q <= r) continue;
+        QP.beamSize = Q;
+        nn_result N = checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP, id_map, QPoints, router);
+        for (long budget : {(long) N.avg_cmps, (long) (N.avg_cmps + N.tail_cmps) / 2}){
+          QP.max_dist_cmps = budget;
+          results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP, id_map, QPoints, router));
         }
+        QP.max_dist_cmps = 0;
       }
       // check "best accuracy"
       QP = QueryParams((long) 100, (long) 1000, (double) 10.0, (long) G.size(), (long) G.max_degree());
-      results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP));
+      QP.rerank_k = QP.beamSize;
+      QP.interleave = interleave;
+      results.push_back(checkRecall<Point, PointRange, indexType>(G, Base_Points, Query_Points, GT, random, start_point, r, QP, id_map, QPoints, router));
 
     parlay::sequence<float> buckets =  {.1, .2, .3,  .4,  .5,  .6, .7, .75,  .8, .85,                                                                                            
                                         .9, .93, .95, .97, .98, .99, .995, .999, .9995, 
@@ -0,0 +1,149 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <set>
+
+#include "csvfile.h"
+#include "graph.h"
+#include "parse_results.h"
+#include "range_search.h"
+#include "reorder.h"
+#include "stats.h"
+#include "types.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+
+// Range searches every query from start_point with beam width QP.beamSize
+// growing to at most slack times that.  The recall is the fraction of all
+// the ground truth matches found, and the alternate recall the average of
+// the fraction found for each query; both count only the queries with at
+// least one match.  The matches of a reordered graph are translated with
+// id_map before they are compared to the ground truth.
+template<typename Point, typename PointRange, typename indexType>
+range_result checkRangeRecall(Graph<indexType> &G, PointRange &Base_Points,
+                              PointRange &Query_Points,
+                              RangeGroundTruth<indexType> &GT, double radius,
+                              indexType start_point, QueryParams &QP,
+                              long slack, parlay::sequence<indexType> &id_map) {
+  if (GT.size() != Query_Points.size()) {
+    std::cout << "ERROR: range ground truth has " << GT.size()
+              << " queries, query file has " << Query_Points.size() << std::endl;
+    abort();
+  }
+  long max_beam = slack * QP.beamSize;
+  parlay::internal::timer t;
+  stats<indexType> QueryStats(Query_Points.size());
+  auto all_matches = searchAllRange<Point, PointRange, indexType>(
+      Query_Points, G, Base_Points, QueryStats, start_point, radius, QP, max_beam);
+  t.next_time();
+  QueryStats.clear();
+  all_matches = searchAllRange<Point, PointRange, indexType>(
+      Query_Points, G, Base_Points, QueryStats, start_point, radius, QP, max_beam);
+  float query_time = t.next_time();
+  if (id_map.size() > 0) to_original_ids(all_matches, id_map);
+
+  size_t n = Query_Points.size();
+  auto correct = parlay::tabulate(n, [&](size_t i) {
+    std::set<indexType> reported(all_matches[i].begin(), all_matches[i].end());
+    size_t c = 0;
+    for (indexType id : GT[i])
+      if (reported.find(id) != reported.end()) c++;
+    return c;
+  });
+  size_t num_nonzero = 0, num_correct = 0, num_matches = 0;
+  double recall_sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (GT.matches(i) == 0) continue;
+    num_nonzero++;
+    num_correct += correct[i];
+    num_matches += GT.matches(i);
+    recall_sum += (double)correct[i] / GT.matches(i);
+  }
+  double recall = num_matches > 0 ? (double)num_correct / num_matches : 0;
+  double alt_recall = num_nonzero > 0 ? recall_sum / num_nonzero : 0;
+
+  auto stats_ = {QueryStats.dist_stats(), QueryStats.visited_stats()};
+  auto flat = parlay::flatten(stats_);
+  parlay::sequence<size_t> stats =
+      parlay::tabulate(flat.size(), [&](size_t i) { return (size_t)flat[i]; });
+  range_result R(n, num_nonzero, recall, alt_recall, stats, n / query_time, 0,
+                 QP.beamSize, QP.cut, slack);
+  R.radius = radius;
+  return R;
+}
+
+void write_range_csv(std::string csv_filename,
+                     parlay::sequence<range_result> results, Graph_ G) {
+  csvfile csv(csv_filename);
+  csv << "GRAPH"
+      << "Parameters"
+      << "Size"
+      << "Build time"
+      << "Avg degree"
+      << "Max degree" << endrow;
+  csv << G.name << G.params << G.size << G.time << G.avg_deg << G.max_deg
+      << endrow;
+  csv << endrow;
+  csv << "Num queries"
+      << "Nonzero queries"
+      << "Radius"
+      << "Recall"
+      << "Alternate recall"
+      << "QPS"
+      << "Average Cmps"
+      << "Tail Cmps"
+      << "Average Visited"
+      << "Tail Visited"
+      << "Q"
+      << "slack" << endrow;
+  for (auto R : results) {
+    csv << R.num_queries << R.num_nonzero_queries << R.radius << R.recall
+        << R.alt_recall << R.QPS << R.avg_cmps << R.tail_cmps << R.avg_visited
+        << R.tail_visited << R.beamQ << R.slack << endrow;
+  }
+  csv << endrow;
+  csv << endrow;
+}
+
+// Range searches the queries with a sweep of starting beam widths and
+// reports the recall, QPS and comparisons of each.
+template<typename Point, typename PointRange, typename indexType>
+void range_search_and_parse(Graph_ G_, Graph<indexType> &G,
+                            PointRange &Base_Points, PointRange &Query_Points,
+                            RangeGroundTruth<indexType> &GT, double radius,
+                            char *res_file,
+                            parlay::sequence<indexType> &id_map) {
+  std::cout << "Range searching with radius " << radius << std::endl;
+  long slack = 8;
+  parlay::sequence<range_result> results;
+  for (long Q : {10, 15, 20, 30, 40, 50, 75, 100, 150, 200, 300, 500, 1000}) {
+    QueryParams QP(0, Q, 1.35, (long)G.size(), (long)G.max_degree());
+    results.push_back(checkRangeRecall<Point, PointRange, indexType>(
+        G, Base_Points, Query_Points, GT, radius, G.start_point(), QP, slack,
+        id_map));
+    results[results.size() - 1].print();
+  }
+  if (res_file != NULL) write_range_csv(std::string(res_file), results, G_);
+}
@@ -0,0 +1,92 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cmath>
+
+#include "distance_kernels.h"
+#include "mips_point.h"
+
+// Points for cosine distance, 1 - <p, q>, on vectors normalized to unit
+// length as they are read: PointRange calls normalize on every row of a
+// range of Cosine_Points, base points and queries alike.  On unit vectors
+// 1 - <p, q> = |p - q|^2 / 2, so unlike mips the distance orders points as
+// a metric does and beam search can trim its frontier with QP.cut.  For
+// float, float16 and bfloat16 vectors; with D > 0 the dimension is fixed
+// at compile time, as for Euclidian_Point.
+template<typename T, unsigned D = 0>
+struct Cosine_Point {
+  using distanceType = float;
+
+  // rounding can put the distance of a point to itself slightly below 0
+  static distanceType d_min() {return -1;}
+  static bool is_metric() {return true;}
+  T operator[](long i){return *(values + i);}
+
+  static constexpr unsigned fixed_dims = D;
+
+  float distance(Cosine_Point<T, D> x) {
+    return 1 + mips_distance<D>(this->values, x.values, d);
+  }
+
+  // distances to the rows base + ids[j] * stride for j < m
+  template<typename indexType>
+  void distance_batch(const T* base, size_t stride, const indexType* ids,
+                      size_t m, float* out) {
+    for_each_row_group(values, base, stride, ids, m, d, out,
+                       dot_rows4<D>(values));
+    for (size_t j = 0; j < m; j++) out[j] = 1 - out[j];
+  }
+
+  // scales row to unit length; zero rows are left as they are
+  static void normalize(T* row, unsigned int d) {
+    float norm = 0;
+    for (unsigned int j = 0; j < d; j++)
+      norm += (float)row[j] * (float)row[j];
+    if (norm == 0) return;
+    float scale = 1 / std::sqrt(norm);
+    for (unsigned int j = 0; j < d; j++) row[j] = (T)((float)row[j] * scale);
+  }
+
+  void prefetch() { prefetch_row(values, aligned_d); }
+
+  long id() {return id_;}
+
+  Cosine_Point(const T* values, unsigned int d, unsigned int ad, long id)
+    : values(values), d(d), aligned_d(ad), id_(id) {}
+
+  bool operator==(Cosine_Point<T, D> q){
+    for (int i = 0; i < d; i++) {
+      if (values[i] != q.values[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  const T* values;
+  unsigned int d;
+  unsigned int aligned_d;
+  long id_;
+};
@@ -0,0 +1,1400 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+
+#include "half.h"
+
+// Distance kernels for float, float16, bfloat16, int8 and uint8 vectors,
+// and Hamming distances between packed bit vectors.  Every kernel is
+// compiled for each instruction set level with a target attribute, and the
+// best level the CPU supports is bound once, on first use, in
+// distance_kernels().  A single binary therefore runs on any x86-64 host
+// and still uses AVX-512 where it is available.  Setting the environment
+// variable PARLAYANN_ISA to scalar, sse2, avx2, avx512 or avx512_vnni caps
+// the level.
+//
+// Each level provides a kernel for one pair of vectors, and a kernel from a
+// query to four rows at once, which the one-to-many batch entry points at
+// the bottom use so that every chunk of the query is loaded once per group
+// and feeds four independent accumulators.  Euclidian kernels return the
+// squared distance, inner product kernels the plain dot product.
+//
+// Byte squared distances take the absolute byte difference, after an xor
+// with 0x80 turns int8 into uint8 with the same differences, and square it
+// in int16 lanes with pmaddwd (vpdpwssd under VNNI).  Dot products widen to
+// int16 and use pmaddwd; pmaddubsw is not used since its pairwise int16
+// sums saturate on full range bytes.  Under VNNI they use vpdpbusd, which
+// multiplies unsigned by signed bytes: the xor with 0x80 moves one operand
+// to the other range, and 128 times the sum of the other operand is taken
+// back out.  All byte results are exact in int32.
+//
+// 16 bit floats are converted to float in registers as they are loaded,
+// float16 with vcvtph2ps (F16C, which AVX2 level CPUs have) and bfloat16
+// by a shift into the upper half of each lane, so they cost half the
+// memory traffic of float for the same arithmetic.  Where the CPU has
+// AVX512_BF16, bfloat16 dot products multiply pairs of lanes directly
+// with vdpbf16ps, see select_distance_kernels.
+//
+// Hamming distances xor 64 bit words and count their bits with popcnt
+// from the AVX2 level on (which implies it), and with vpopcntq on 64
+// bytes at a time where the CPU has AVX512_VPOPCNTDQ.
+//
+// The float, byte and 16 bit float kernels take an optional dimension D as
+// a template argument, which replaces d when it is not 0.  With the trip
+// counts known the compiler unrolls the loops and drops the tail handling
+// that D does not need; distance_kernels<D>() binds these kernels for the
+// points of PointRanges whose dimension is fixed at compile time.
+//
+// The bounded squared distances for float and 16 bit floats stop adding
+// once the distance is known to exceed a bound, such as the worst
+// distance on a full beam, see bounded_block.
+
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define TARGET_AVX512 \
+  __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq")))
+#define TARGET_AVX512_VNNI \
+  __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,avx512vnni")))
+#define TARGET_AVX512_BF16 \
+  __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,avx512bf16")))
+#define TARGET_POPCNT __attribute__((target("popcnt")))
+#define TARGET_AVX512_VPOPCNTDQ                                         \
+  __attribute__((                                                      \
+      target("avx512f,avx512bw,avx512vl,avx512dq,avx512vpopcntdq")))
+
+// *************************************************************
+//  scalar
+// *************************************************************
+
+template <bool L2, unsigned D = 0>
+float float_distance_scalar(const float* p, const float* q, unsigned d) {
+  if (D) d = D;
+  float result = 0;
+  for (unsigned i = 0; i < d; i++)
+    result += L2 ? (p[i] - q[i]) * (p[i] - q[i]) : p[i] * q[i];
+  return result;
+}
+
+template <bool L2, unsigned D = 0>
+void float_rows4_scalar(const float* q, const float* const* r, unsigned d,
+                        float* out) {
+  if (D) d = D;
+  float acc[4] = {0, 0, 0, 0};
+  for (unsigned i = 0; i < d; i++)
+    for (int l = 0; l < 4; l++)
+      acc[l] += L2 ? (q[i] - r[l][i]) * (q[i] - r[l][i]) : q[i] * r[l][i];
+  for (int l = 0; l < 4; l++) out[l] = acc[l];
+}
+
+template <bool L2, typename T, unsigned D = 0>
+int byte_distance_scalar(const T* p, const T* q, unsigned d) {
+  if (D) d = D;
+  int result = 0;
+  for (unsigned i = 0; i < d; i++) {
+    int a = p[i], b = q[i];
+    result += L2 ? (a - b) * (a - b) : a * b;
+  }
+  return result;
+}
+
+template <bool L2, typename T, unsigned D = 0>
+void byte_rows4_scalar(const T* q, const T* const* r, unsigned d,
+                       float* out) {
+  if (D) d = D;
+  int acc[4] = {0, 0, 0, 0};
+  for (unsigned i = 0; i < d; i++)
+    for (int l = 0; l < 4; l++) {
+      int a = q[i], b = r[l][i];
+      acc[l] += L2 ? (a - b) * (a - b) : a * b;
+    }
+  for (int l = 0; l < 4; l++) out[l] = (float)acc[l];
+}
+
+template <bool L2, typename H, unsigned D = 0>
+float half_distance_scalar(const H* p, const H* q, unsigned d) {
+  if (D) d = D;
+  float result = 0;
+  for (unsigned i = 0; i < d; i++) {
+    float a = p[i], b = q[i];
+    result += L2 ? (a - b) * (a - b) : a * b;
+  }
+  return result;
+}
+
+template <bool L2, typename H, unsigned D = 0>
+void half_rows4_scalar(const H* q, const H* const* r, unsigned d,
+                       float* out) {
+  if (D) d = D;
+  float acc[4] = {0, 0, 0, 0};
+  for (unsigned i = 0; i < d; i++) {
+    float a = q[i];
+    for (int l = 0; l < 4; l++) {
+      float b = r[l][i];
+      acc[l] += L2 ? (a - b) * (a - b) : a * b;
+    }
+  }
+  for (int l = 0; l < 4; l++) out[l] = acc[l];
+}
+
+// the number of differing bits of d bytes, a word at a time
+inline int hamming_words(const uint8_t* p, const uint8_t* q, unsigned d) {
+  int result = 0;
+  unsigned i = 0;
+  for (; i + 8 <= d; i += 8) {
+    uint64_t a, b;
+    std::memcpy(&a, p + i, 8);
+    std::memcpy(&b, q + i, 8);
+    result += __builtin_popcountll(a ^ b);
+  }
+  for (; i < d; i++) result += __builtin_popcount(p[i] ^ q[i]);
+  return result;
+}
+
+inline int hamming_scalar(const uint8_t* p, const uint8_t* q, unsigned d) {
+  return hamming_words(p, q, d);
+}
+
+// the same loop, with __builtin_popcountll inlined as the instruction
+TARGET_POPCNT inline int hamming_popcnt(const uint8_t* p, const uint8_t* q,
+                                        unsigned d) {
+  return hamming_words(p, q, d);
+}
+
+// *************************************************************
+//  SSE2
+// *************************************************************
+
+TARGET_SSE2 inline float hsum_sse2(__m128 v) {
+  __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+TARGET_SSE2 inline int hsum_epi32_sse2(__m128i v) {
+  __m128i s = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+  return _mm_cvtsi128_si32(s);
+}
+
+template <bool L2>
+TARGET_SSE2 inline __m128 float_step_sse2(__m128 acc, __m128 a, __m128 b) {
+  if (L2) {
+    __m128 diff = _mm_sub_ps(a, b);
+    return _mm_add_ps(acc, _mm_mul_ps(diff, diff));
+  }
+  return _mm_add_ps(acc, _mm_mul_ps(a, b));
+}
+
+// the low or high eight bytes of v widened to int16
+TARGET_SSE2 inline __m128i widen_lo_sse2(__m128i v, const uint8_t*) {
+  return _mm_unpacklo_epi8(v, _mm_setzero_si128());
+}
+TARGET_SSE2 inline __m128i widen_hi_sse2(__m128i v, const uint8_t*) {
+  return _mm_unpackhi_epi8(v, _mm_setzero_si128());
+}
+TARGET_SSE2 inline __m128i widen_lo_sse2(__m128i v, const int8_t*) {
+  return _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+}
+TARGET_SSE2 inline __m128i widen_hi_sse2(__m128i v, const int8_t*) {
+  return _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+}
+
+template <bool L2>
+TARGET_SSE2 inline __m128i byte_step_sse2(__m128i acc, __m128i a, __m128i b) {
+  if (L2) {
+    __m128i diff = _mm_sub_epi16(a, b);
+    return _mm_add_epi32(acc, _mm_madd_epi16(diff, diff));
+  }
+  return _mm_add_epi32(acc, _mm_madd_epi16(a, b));
+}
+
+template <bool L2, unsigned D = 0>
+TARGET_SSE2 float float_distance_sse2(const float* p, const float* q,
+                                      unsigned d) {
+  if (D) d = D;
+  __m128 acc = _mm_setzero_ps();
+  unsigned i = 0;
+  for (; i + 4 <= d; i += 4)
+    acc = float_step_sse2<L2>(acc, _mm_loadu_ps(p + i), _mm_loadu_ps(q + i));
+  return hsum_sse2(acc) + float_distance_scalar<L2>(p + i, q + i, d - i);
+}
+
+template <bool L2, unsigned D = 0>
+TARGET_SSE2 void float_rows4_sse2(const float* q, const float* const* r,
+                                  unsigned d, float* out) {
+  if (D) d = D;
+  __m128 acc[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(),
+                   _mm_setzero_ps()};
+  unsigned i = 0;
+  for (; i + 4 <= d; i += 4) {
+    __m128 qv = _mm_loadu_ps(q + i);
+    for (int l = 0; l < 4; l++)
+      acc[l] = float_step_sse2<L2>(acc[l], qv, _mm_loadu_ps(r[l] + i));
+  }
+  for (int l = 0; l < 4; l++)
+    out[l] = hsum_sse2(acc[l]) +
+             float_distance_scalar<L2>(q + i, r[l] + i, d - i);
+}
+
+template <bool L2, typename T, unsigned D = 0>
+TARGET_SSE2 int byte_distance_sse2(const T* p, const T* q, unsigned d) {
+  if (D) d = D;
+  __m128i acc = _mm_setzero_si128();
+  unsigned i = 0;
+  for (; i + 16 <= d; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(p + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(q + i));
+    acc = byte_step_sse2<L2>(acc, widen_lo_sse2(a, p), widen_lo_sse2(b, p));
+    acc = byte_step_sse2<L2>(acc, widen_hi_sse2(a, p), widen_hi_sse2(b, p));
+  }
+  return hsum_epi32_sse2(acc) +
+         byte_distance_scalar<L2>(p + i, q + i, d - i);
+}
+
+template <bool L2, typename T, unsigned D = 0>
+TARGET_SSE2 void byte_rows4_sse2(const T* q, const T* const* r, unsigned d,
+                                 float* out) {
+  if (D) d = D;
+  __m128i acc[4] = {_mm_setzero_si128(), _mm_setzero_si128(),
+                    _mm_setzero_si128(), _mm_setzero_si128()};
+  unsigned i = 0;
+  for (; i + 8 <= d; i += 8) {
+    __m128i qv = widen_lo_sse2(_mm_loadl_epi64((const __m128i*)(q + i)), q);
+    for (int l = 0; l < 4; l++) {
+      __m128i rv =
+          widen_lo_sse2(_mm_loadl_epi64((const __m128i*)(r[l] + i)), q);
+      acc[l] = byte_step_sse2<L2>(acc[l], qv, rv);
+    }
+  }
+  for (int l = 0; l < 4; l++)
+    out[l] = (float)(hsum_epi32_sse2(acc[l]) +
+                     byte_distance_scalar<L2>(q + i, r[l] + i, d - i));
+}
+
+// *************************************************************
+//  AVX2
+// *************************************************************
+
+TARGET_AVX2 inline float hsum_avx2(__m256 v) {
+  return hsum_sse2(
+      _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+TARGET_AVX2 inline int hsum_epi32_avx2(__m256i v) {
+  return hsum_epi32_sse2(_mm_add_epi32(_mm256_castsi256_si128(v),
+                                       _mm256_extracti128_si256(v, 1)));
+}
+
+template <bool L2>
+TARGET_AVX2 inline __m256 float_step_avx2(__m256 acc, __m256 a, __m256 b) {
+  if (L2) {
+    __m256 diff = _mm256_sub_ps(a, b);
+    return _mm256_fmadd_ps(diff, diff, acc);
+  }
+  return _mm256_fmadd_ps(a, b, acc);
+}
+
+TARGET_AVX2 inline __m256i widen_avx2(__m128i v, const uint8_t*) {
+  return _mm256_cvtepu8_epi16(v);
+}
+TARGET_AVX2 inline __m256i widen_avx2(__m128i v, const int8_t*) {
+  return _mm256_cvtepi8_epi16(v);
+}
+
+template <bool L2>
+TARGET_AVX2 inline __m256i byte_step_avx2(__m256i acc, __m256i a, __m256i b) {
+  if (L2) {
+    __m256i diff = _mm256_sub_epi16(a, b);
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(diff, diff));
+  }
+  return _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+}
+
+template <bool L2, unsigned D = 0>
+TARGET_AVX2 float float_distance_avx2(const float* p, const float* q,
+                                      unsigned d) {
+  if (D) d = D;
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  unsigned i = 0;
+  for (; i + 16 <= d; i += 16) {
+    acc0 = float_step_avx2<L2>(acc0, _mm256_loadu_ps(p + i),
+                               _mm256_loadu_ps(q + i));
+    acc1 = float_step_avx2<L2>(acc1, _mm256_loadu_ps(p + i + 8),
+                               _mm256_loadu_ps(q + i + 8));
+  }
+  for (; i + 8 <= d; i += 8)
+    acc0 = float_step_avx2<L2>(acc0, _mm256_loadu_ps(p + i),
+                               _mm256_loadu_ps(q + i));
+  return hsum_avx2(_mm256_add_ps(acc0, acc1)) +
+         float_distance_scalar<L2>(p + i, q + i, d - i);
+}
+
+template <bool L2, unsigned D = 0>
+TARGET_AVX2 void float_rows4_avx2(const float* q, const float* const* r,
+                                  unsigned d, float* out) {
+  if (D) d = D;
+  __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),
+                   _mm256_setzero_ps(), _mm256_setzero_ps()};
+  unsigned i = 0;
+  for (; i + 8 <= d; i += 8) {
+    __m256 qv = _mm256_loadu_ps(q + i);
+    for (int l = 0; l < 4; l++)
+      acc[l] = float_step_avx2<L2>(acc[l], qv, _mm256_loadu_ps(r[l] + i));
+  }
+  for (int l = 0; l < 4; l++)
+    out[l] = hsum_avx2(acc[l]) +
+             float_distance_scalar<L2>(q + i, r[l] + i, d - i);
+}
+
+// eight 16 bit floats as floats
+TARGET_AVX2 inline __m256 half_load_avx2(const float16* p) {
+  return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)p));
+}
+TARGET_AVX2 inline __m256 half_load_avx2(const bfloat16* p) {
+  __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+  return _mm256_castsi256_ps(_mm256_slli_epi32(v, 16));
+}
+
+template <bool L2, typename H, unsigned D = 0>
+TARGET_AVX2 float half_distance_avx2(const H* p, const H* q, unsigned d) {
+  if (D) d = D;
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  unsigned i = 0;
+  for (; i + 16 <= d; i += 16) {
+    acc0 = float_step_avx2<L2>(acc0, half_load_avx2(p + i),
+                               half_load_avx2(q + i));
+    acc1 = float_step_avx2<L2>(acc1, half_load_avx2(p + i + 8),
+                               half_load_avx2(q + i + 8));
+  }
+  for (; i + 8 <= d; i += 8)
+    acc0 = float_step_avx2<L2>(acc0, half_load_avx2(p + i),
+                               half_load_avx2(q + i));
+  return hsum_avx2(_mm256_add_ps(acc0, acc1)) +
+         half_distance_scalar<L2>(p + i, q + i, d - i);
+}
+
+template <bool L2, typename H, unsigned D = 0>
+TARGET_AVX2 void half_rows4_avx2(const H* q, const H* const* r, unsigned d,
+                                 float* out) {
+  if (D) d = D;
+  __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),
+                   _mm256_setzero_ps(), _mm256_setzero_ps()};
+  unsigned i = 0;
+  for (; i + 8 <= d; i += 8) {
+    __m256 qv = half_load_avx2(q + i);
+    for (int l = 0; l < 4; l++)
+      acc[l] = float_step_avx2<L2>(acc[l], qv, half_load_avx2(r[l] + i));
+  }
+  for (int l = 0; l < 4; l++)
+    out[l] = hsum_avx2(acc[l]) +
+             half_distance_scalar<L2>(q + i, r[l] + i, d - i);
+}
+
+template <typename T, unsigned D = 0>
+TARGET_AVX2 int byte_l2_avx2(const T* p, const T* q, unsigned d) {
+  if (D) d = D;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i flip = _mm256_set1_epi8(std::is_signed<T>::value ? 0x80 : 0);
+  __m256i acc = zero;
+  unsigned i = 0;
+  for (; i + 32 <= d; i += 32) {
+    __m256i a =
+        _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p + i)), flip);
+    __m256i b =
+        _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(q + i)), flip);
+    __m256i diff =
+        _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+    __m256i lo = _mm256_unpacklo_epi8(diff, zero);
+    __m256i hi = _mm256_unpackhi_epi8(diff, zero);
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(lo, lo));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(hi, hi));
+  }
+  return hsum_epi32_avx2(acc) +
+         byte_distance_scalar<true>(p + i, q + i, d - i);
+}
+
+template <typename T, unsigned D = 0>
+TARGET_AVX2 int byte_dot_avx2(const T* p, const T* q, unsigned d) {
+  if (D) d = D;
+  __m256i acc = _mm256_setzero_si256();
+  unsigned i = 0;
+  for (; i + 16 <= d; i += 16) {
+    __m256i a = widen_avx2(_mm_loadu_si128((const __m128i*)(p + i)), p);
+    __m256i b = widen_avx2(_mm_loadu_si128((const __m128i*)(q + i)), p);
+    acc = byte_step_avx2<false>(acc, a, b);
+  }
+  return hsum_epi32_avx2(acc) +
+         byte_distance_scalar<false>(p + i, q + i, d - i);
+}
+
+template <bool L2, typename T, unsigned D = 0>
+TARGET_AVX2 void byte_rows4_avx2(const T* q, const T* const* r, unsigned d,
+                                 float* out) {
+  if (D) d = D;
+  __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(),
+                    _mm256_setzero_si256(), _mm256_setzero_si256()};
+  unsigned i = 0;
+  for (; i + 16 <= d; i += 16) {
+    __m256i qv = widen_avx2(_mm_loadu_si128((const __m128i*)(q + i)), q);
+    for (int l = 0; l < 4; l++) {
+      __m256i rv = widen_avx2(_mm_loadu_si128((const __m128i*)(r[l] + i)), q);
+      acc[l] = byte_step_avx2<L2>(acc[l], qv, rv);
+    }
+  }
+  for (int l = 0; l < 4; l++)
+    out[l] = (float)(hsum_epi32_avx2(acc[l]) +
+                     byte_distance_scalar<L2>(q + i, r[l] + i, d - i));
+}
+
+// *************************************************************
+//  AVX-512
+// *************************************************************
+
+// tails are handled with masked loads, which read zeros past the end
+TARGET_AVX512 inline __mmask16 tail_mask16(unsigned n) {
+  return n >= 16 ? 0xFFFF : (__mmask16)((1u << n) - 1);
+}
+TARGET_AVX512 inline __mmask32 tail_mask32(unsigned n) {
+  return n >= 32 ? 0xFFFFFFFFu : (__mmask32)((1u << n) - 1);
+}
+TARGET_AVX512 inline __mmask64 tail_mask64(unsigned n) {
+  return n >= 64 ? ~0ull : (1ull << n) - 1;
+}
+
+template <bool L2>
+TARGET_AVX512 inline __m512 float_step_avx512(__m512 acc, __m512 a,
+                                              __m512 b) {
+  if (L2) {
+    __m512 diff = _mm512_sub_ps(a, b);
+    return _mm512_fmadd_ps(diff, diff, acc);
+  }
+  return _mm512_fmadd_ps(a, b, acc);
+}
+
+TARGET_AVX512 inline __m512i widen_avx512(__m256i v, const uint8_t*) {
+  return _mm512_cvtepu8_epi16(v);
+}
+TARGET_AVX512 inline __m512i widen_avx512(__m256i v, const int8_t*) {
+  return _mm512_cvtepi8_epi16(v);
+}
+
+template <bool L2>
+TARGET_AVX512 inline __m512i byte_step_avx512(__m512i acc, __m512i a,
+                                              __m512i b) {
+  if (L2) {
+    __m512i diff = _mm512_sub_epi16(a, b);
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(diff, diff));
+  }
+  return _mm512_add_epi32(acc, _mm512_madd_epi16(a, b));
+}
+
+// the absolute differences of the bytes of p and q, as unsigned bytes
+template <typename T>
+TARGET_AVX512 inline __m512i byte_absdiff_avx512(const T* p, const T* q,
+                                                 __mmask64 mask) {
+  const __m512i flip = _mm512_set1_epi8(std::is_signed<T>::value ? 0x80 : 0);
+  __m512i a = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, p), flip);
+  __m512i b = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, q), flip);
+  return _mm512_or_si512(_mm512_subs_epu8(a, b), _mm512_subs_epu8(b, a));
+}
+
+template <bool L2, unsigned D = 0>
+TARGET_AVX512 float float_distance_avx512(const float* p, const float* q,
+                                          unsigned d) {
+  if (D) d = D;
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  unsigned i = 0;
+  for (; i + 32 <= d; i += 32) {
+    acc0 = float_step_avx512<L2>(acc0, _mm512_loadu_ps(p + i),
+                                 _mm512_loadu_ps(q + i));
+    acc1 = float_step_avx512<L2>(acc1, _mm512_loadu_ps(p + i + 16),
+                                 _mm512_loadu_ps(q + i + 16));
+  }
+  for (; i < d; i += 16) {
+    __mmask16 mask = tail_mask16(d - i);
+    acc0 = float_step_avx512<L2>(acc0, _mm512_maskz_loadu_ps(mask, p + i),
+                                 _mm512_maskz_loadu_ps(mask, q + i));
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+template <bool L2, unsigned D = 0>
+TARGET_AVX512 void float_rows4_avx512(const float* q, const float* const* r,
+                                      unsigned d, float* out) {
+  if (D) d = D;
+  __m512 acc[4] = {_mm512_setzero_ps(), _mm512_setzero_ps(),
+                   _mm512_setzero_ps(), _mm512_setzero_ps()};
+  for (unsigned i = 0; i < d; i += 16) {
+    __mmask16 mask = tail_mask16(d - i);
+    __m512 qv = _mm512_maskz_loadu_ps(mask, q + i);
+    for (int l = 0; l < 4; l++)
+      acc[l] = float_step_avx512<L2>(acc[l], qv,
+                                     _mm512_maskz_loadu_ps(mask, r[l] + i));
+  }
+  for (int l = 0; l < 4; l++) out[l] = _mm512_reduce_add_ps(acc[l]);
+}
+
+// the first n <= 16 of sixteen 16 bit floats as floats, the rest zero
+TARGET_AVX512 inline __m512 half_load_avx512(const float16* p, unsigned n) {
+  return _mm512_cvtph_ps(_mm256_maskz_loadu_epi16(tail_mask16(n), p));
+}
+TARGET_AVX512 inline __m512 half_load_avx512(const bfloat16* p, unsigned n) {
+  __m512i v =
+      _mm512_cvtepu16_epi32(_mm256_maskz_loadu_epi16(tail_mask16(n), p));
+  return _mm512_castsi512_ps(_mm512_slli_epi32(v, 16));
+}
+
+template <bool L2, typename H, unsigned D = 0>
+TARGET_AVX512 float half_distance_avx512(const H* p, const H* q,
+                                         unsigned d) {
+  if (D) d = D;
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  unsigned i = 0;
+  for (; i + 32 <= d; i += 32) {
+    acc0 = float_step_avx512<L2>(acc0, half_load_avx512(p + i, 16),
+                                 half_load_avx512(q + i, 16));
+    acc1 = float_step_avx512<L2>(acc1, half_load_avx512(p + i + 16, 16),
+                                 half_load_avx512(q + i + 16, 16));
+  }
+  for (; i < d; i += 16)
+    acc0 = float_step_avx512<L2>(acc0, half_load_avx512(p + i, d - i),
+                                 half_load_avx512(q + i, d - i));
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+template <bool L2, typename H, unsigned D = 0>
+TARGET_AVX512 void half_rows4_avx512(const H* q, const H* const* r,
+                                     unsigned d, float* out) {
+  if (D) d = D;
+  __m512 acc[4] = {_mm512_setzero_ps(), _mm512_setzero_ps(),
+                   _mm512_setzero_ps(), _mm512_setzero_ps()};
+  for (unsigned i = 0; i < d; i += 16) {
+    __m512 qv = half_load_avx512(q + i, d - i);
+    for (int l = 0; l < 4; l++)
+      acc[l] = float_step_avx512<L2>(acc[l], qv,
+                                     half_load_avx512(r[l] + i, d - i));
+  }
+  for (int l = 0; l < 4; l++) out[l] = _mm512_reduce_add_ps(acc[l]);
+}
+
+template <typename T, unsigned D = 0>
+TARGET_AVX512 int byte_l2_avx512(const T* p, const T* q, unsigned d) {
+  if (D) d = D;
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i acc = zero;
+  for (unsigned i = 0; i < d; i += 64) {
+    __m512i diff = byte_absdiff_avx512(p + i, q + i, tail_mask64(d - i));
+    __m512i lo = _mm512_unpacklo_epi8(diff, zero);
+    __m512i hi = _mm512_unpackhi_epi8(diff, zero);
+    acc = _mm512_add_epi32(acc, _mm512_madd_epi16(lo, lo));
+    acc = _mm512_add_epi32(acc, _mm512_madd_epi16(hi, hi));
+  }
+  return _mm512_reduce_add_epi32(acc);
+}
+
+template <typename T, unsigned D = 0>
+TARGET_AVX512 int byte_dot_avx512(const T* p, const T* q, unsigned d) {
+  if (D) d = D;
+  __m512i acc = _mm512_setzero_si512();
+  for (unsigned i = 0; i < d; i += 32) {
+    __mmask32 mask = tail_mask32(d - i);
+    __m512i a = widen_avx512(_mm256_maskz_loadu_epi8(mask, p + i), p);
+    __m512i b = widen_avx512(_mm256_maskz_loadu_epi8(mask, q + i), p);
+    acc = byte_step_avx512<false>(acc, a, b);
+  }
+  return _mm512_reduce_add_epi32(acc);
+}
+
+template <bool L2, typename T, unsigned D = 0>
+TARGET_AVX512 void byte_rows4_avx512(const T* q, const T* const* r,
+                                     unsigned d, float* out) {
+  if (D) d = D;
+  __m512i acc[4] = {_mm512_setzero_si512(), _mm512_setzero_si512(),
+                    _mm512_setzero_si512(), _mm512_setzero_si512()};
+  for (unsigned i = 0; i < d; i += 32) {
+    __mmask32 mask = tail_mask32(d - i);
+    __m512i qv = widen_avx512(_mm256_maskz_loadu_epi8(mask, q + i), q);
+    for (int l = 0; l < 4; l++) {
+      __m512i rv = widen_avx512(_mm256_maskz_loadu_epi8(mask, r[l] + i), q);
+      acc[l] = byte_step_avx512<L2>(acc[l], qv, rv);
+    }
+  }
+  for (int l = 0; l < 4; l++) out[l] = (float)_mm512_reduce_add_epi32(acc[l]);
+}
+
+// *************************************************************
+//  AVX-512 VNNI (byte kernels only, floats use AVX-512)
+// *************************************************************
+
+template <typename T, unsigned D = 0>
+TARGET_AVX512_VNNI int byte_l2_avx512_vnni(const T* p, const T* q,
+                                           unsigned d) {
+  if (D) d = D;
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i acc = zero;
+  for (unsigned i = 0; i < d; i += 64) {
+    __m512i diff = byte_absdiff_avx512(p + i, q + i, tail_mask64(d - i));
+    __m512i lo = _mm512_unpacklo_epi8(diff, zero);
+    __m512i hi = _mm512_unpackhi_epi8(diff, zero);
+    acc = _mm512_dpwssd_epi32(acc, lo, lo);
+    acc = _mm512_dpwssd_epi32(acc, hi, hi);
+  }
+  return _mm512_reduce_add_epi32(acc);
+}
+
+template <unsigned D = 0>
+TARGET_AVX512_VNNI inline int byte_dot_avx512_vnni(const uint8_t* p,
+                                                   const uint8_t* q,
+                                                   unsigned d) {
+  if (D) d = D;
+  const __m512i flip = _mm512_set1_epi8((char)0x80);
+  const __m512i ones = _mm512_set1_epi8(1);
+  __m512i acc = _mm512_setzero_si512(), sum = _mm512_setzero_si512();
+  for (unsigned i = 0; i < d; i += 64) {
+    __mmask64 mask = tail_mask64(d - i);
+    __m512i a = _mm512_maskz_loadu_epi8(mask, p + i);
+    __m512i b = _mm512_maskz_loadu_epi8(mask, q + i);
+    // a . (b - 128) + 128 * sum(a)
+    acc = _mm512_dpbusd_epi32(acc, a, _mm512_xor_si512(b, flip));
+    sum = _mm512_dpbusd_epi32(sum, a, ones);
+  }
+  return _mm512_reduce_add_epi32(acc) + 128 * _mm512_reduce_add_epi32(sum);
+}
+
+template <unsigned D = 0>
+TARGET_AVX512_VNNI inline int byte_dot_avx512_vnni(const int8_t* p,
+                                                   const int8_t* q,
+                                                   unsigned d) {
+  if (D) d = D;
+  const __m512i flip = _mm512_set1_epi8((char)0x80);
+  const __m512i ones = _mm512_set1_epi8(1);
+  __m512i acc = _mm512_setzero_si512(), sum = _mm512_setzero_si512();
+  for (unsigned i = 0; i < d; i += 64) {
+    __mmask64 mask = tail_mask64(d - i);
+    __m512i a = _mm512_maskz_loadu_epi8(mask, p + i);
+    __m512i b = _mm512_maskz_loadu_epi8(mask, q + i);
+    // (a + 128) . b - 128 * sum(b)
+    acc = _mm512_dpbusd_epi32(acc, _mm512_xor_si512(a, flip), b);
+    sum = _mm512_dpbusd_epi32(sum, ones, b);
+  }
+  return _mm512_reduce_add_epi32(acc) - 128 * _mm512_reduce_add_epi32(sum);
+}
+
+template <bool L2, typename T, unsigned D = 0>
+TARGET_AVX512_VNNI void byte_rows4_avx512_vnni(const T* q, const T* const* r,
+                                               unsigned d, float* out) {
+  if (D) d = D;
+  __m512i acc[4] = {_mm512_setzero_si512(), _mm512_setzero_si512(),
+                    _mm512_setzero_si512(), _mm512_setzero_si512()};
+  for (unsigned i = 0; i < d; i += 32) {
+    __mmask32 mask = tail_mask32(d - i);
+    __m512i qv = widen_avx512(_mm256_maskz_loadu_epi8(mask, q + i), q);
+    for (int l = 0; l < 4; l++) {
+      __m512i rv = widen_avx512(_mm256_maskz_loadu_epi8(mask, r[l] + i), q);
+      if (L2) {
+        __m512i diff = _mm512_sub_epi16(qv, rv);
+        acc[l] = _mm512_dpwssd_epi32(acc[l], diff, diff);
+      } else {
+        acc[l] = _mm512_dpwssd_epi32(acc[l], qv, rv);
+      }
+    }
+  }
+  for (int l = 0; l < 4; l++) out[l] = (float)_mm512_reduce_add_epi32(acc[l]);
+}
+
+// *************************************************************
+//  AVX512_BF16 (bfloat16 dot products only)
+// *************************************************************
+
+// vdpbf16ps adds the products of pairs of bfloat16 lanes to float lanes
+TARGET_AVX512_BF16 inline __m512 bf16_dot_step(__m512 acc, const bfloat16* p,
+                                               const bfloat16* q,
+                                               unsigned n) {
+  __mmask32 mask = tail_mask32(n);
+  __m512i a = _mm512_maskz_loadu_epi16(mask, p);
+  __m512i b = _mm512_maskz_loadu_epi16(mask, q);
+  return _mm512_dpbf16_ps(acc, (__m512bh)a, (__m512bh)b);
+}
+
+TARGET_AVX512_BF16 inline float bfloat16_dot_avx512_bf16(const bfloat16* p,
+                                                         const bfloat16* q,
+                                                         unsigned d) {
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  unsigned i = 0;
+  for (; i + 64 <= d; i += 64) {
+    acc0 = bf16_dot_step(acc0, p + i, q + i, 32);
+    acc1 = bf16_dot_step(acc1, p + i + 32, q + i + 32, 32);
+  }
+  for (; i < d; i += 32) acc0 = bf16_dot_step(acc0, p + i, q + i, d - i);
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+TARGET_AVX512_BF16 inline void bfloat16_dot_rows4_avx512_bf16(
+    const bfloat16* q, const bfloat16* const* r, unsigned d, float* out) {
+  __m512 acc[4] = {_mm512_setzero_ps(), _mm512_setzero_ps(),
+                   _mm512_setzero_ps(), _mm512_setzero_ps()};
+  for (unsigned i = 0; i < d; i += 32)
+    for (int l = 0; l < 4; l++)
+      acc[l] = bf16_dot_step(acc[l], q + i, r[l] + i, d - i);
+  for (int l = 0; l < 4; l++) out[l] = _mm512_reduce_add_ps(acc[l]);
+}
+
+// *************************************************************
+//  AVX512_VPOPCNTDQ (Hamming distances only)
+// *************************************************************
+
+TARGET_AVX512_VPOPCNTDQ inline int hamming_avx512_vpopcntdq(
+    const uint8_t* p, const uint8_t* q, unsigned d) {
+  __m512i acc = _mm512_setzero_si512();
+  for (unsigned i = 0; i < d; i += 64) {
+    __mmask64 mask = tail_mask64(d - i);
+    __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, p + i),
+                                 _mm512_maskz_loadu_epi8(mask, q + i));
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+  }
+  return (int)_mm512_reduce_add_epi64(acc);
+}
+
+// *************************************************************
+//  bounded squared distances (float and 16 bit floats)
+// *************************************************************
+
+// Squared Euclidian distances from a query to four rows that check the
+// partial sums every bounded_block dimensions, stop adding for the rows
+// whose partial sum exceeds bounds[l], and return once no row is left.
+// Partial sums only grow, so a result above its bound only says that the
+// distance is above it, while a result at most its bound is the distance,
+// summed in the same order as the unbounded rows4 kernel of the level.
+constexpr unsigned bounded_block = 128;
+
+// drops the rows whose partial sums exceed their bounds, true if any is left
+inline bool bounded_rows_left(const float* partial, const float* bounds,
+                              bool* left) {
+  bool any = false;
+  for (int l = 0; l < 4; l++) {
+    left[l] = left[l] && partial[l] <= bounds[l];
+    any = any || left[l];
+  }
+  return any;
+}
+
+template <unsigned D = 0>
+void float_l2_rows4_bounded_scalar(const float* q, const float* const* r,
+                                   unsigned d, const float* bounds,
+                                   float* out) {
+  if (D) d = D;
+  float acc[4] = {0, 0, 0, 0};
+  bool left[4] = {true, true, true, true};
+  for (unsigned i = 0; i < d;) {
+    unsigned e = std::min(d, i + bounded_block);
+    for (; i < e; i++)
+      for (int l = 0; l < 4; l++)
+        if (left[l]) acc[l] += (q[i] - r[l][i]) * (q[i] - r[l][i]);
+    if (i < d && !bounded_rows_left(acc, bounds, left)) break;
+  }
+  for (int l = 0; l < 4; l++) out[l] = acc[l];
+}
+
+template <typename H, unsigned D = 0>
+void half_l2_rows4_bounded_scalar(const H* q, const H* const* r, unsigned d,
+                                  const float* bounds, float* out) {
+  if (D) d = D;
+  float acc[4] = {0, 0, 0, 0};
+  bool left[4] = {true, true, true, true};
+  for (unsigned i = 0; i < d;) {
+    unsigned e = std::min(d, i + bounded_block);
+    for (; i < e; i++) {
+      float a = q[i];
+      for (int l = 0; l < 4; l++) {
+        float b = r[l][i];
+        if (left[l]) acc[l] += (a - b) * (a - b);
+      }
+    }
+    if (i < d && !bounded_rows_left(acc, bounds, left)) break;
+  }
+  for (int l = 0; l < 4; l++) out[l] = acc[l];
+}
+
+template <unsigned D = 0>
+TARGET_SSE2 void float_l2_rows4_bounded_sse2(const float* q,
+                                             const float* const* r,
+                                             unsigned d, const float* bounds,
+                                             float* out) {
+  if (D) d = D;
+  __m128 acc[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(),
+                   _mm_setzero_ps()};
+  bool left[4] = {true, true, true, true};
+  float partial[4];
+  unsigned i = 0;
+  while (i + 4 <= d) {
+    unsigned e = std::min(d & ~3u, i + bounded_block);
+    for (; i < e; i += 4) {
+      __m128 qv = _mm_loadu_ps(q + i);
+      for (int l = 0; l < 4; l++)
+        if (left[l])
+          acc[l] = float_step_sse2<true>(acc[l], qv, _mm_loadu_ps(r[l] + i));
+    }
+    if (i + 4 > d) break;
+    for (int l = 0; l < 4; l++) partial[l] = hsum_sse2(acc[l]);
+    if (!bounded_rows_left(partial, bounds, left)) {
+      for (int l = 0; l < 4; l++) out[l] = partial[l];
+      return;
+    }
+  }
+  for (int l = 0; l < 4; l++)
+    out[l] = hsum_sse2(acc[l]) +
+             float_distance_scalar<true>(q + i, r[l] + i, d - i);
+}
+
+template <unsigned D = 0>
+TARGET_AVX2 void float_l2_rows4_bounded_avx2(const float* q,
+                                             const float* const* r,
+                                             unsigned d, const float* bounds,
+                                             float* out) {
+  if (D) d = D;
+  __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),
+                   _mm256_setzero_ps(), _mm256_setzero_ps()};
+  bool left[4] = {true, true, true, true};
+  float partial[4];
+  unsigned i = 0;
+  while (i + 8 <= d) {
+    unsigned e = std::min(d & ~7u, i + bounded_block);
+    for (; i < e; i += 8) {
+      __m256 qv = _mm256_loadu_ps(q + i);
+      for (int l = 0; l < 4; l++)
+        if (left[l])
+          acc[l] =
+              float_step_avx2<true>(acc[l], qv, _mm256_loadu_ps(r[l] + i));
+    }
+    if (i + 8 > d) break;
+    for (int l = 0; l < 4; l++) partial[l] = hsum_avx2(acc[l]);
+    if (!bounded_rows_left(partial, bounds, left)) {
+      for (int l = 0; l < 4; l++) out[l] = partial[l];
+      return;
+    }
+  }
+  for (int l = 0; l < 4; l++)
+    out[l] = hsum_avx2(acc[l]) +
+             float_distance_scalar<true>(q + i, r[l] + i, d - i);
+}
+
+template <typename H, unsigned D = 0>
+TARGET_AVX2 void half_l2_rows4_bounded_avx2(const H* q, const H* const* r,
+                                            unsigned d, const float* bounds,
+                                            float* out) {
+  if (D) d = D;
+  __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),
+                   _mm256_setzero_ps(), _mm256_setzero_ps()};
+  bool left[4] = {true, true, true, true};
+  float partial[4];
+  unsigned i = 0;
+  while (i + 8 <= d) {
+    unsigned e = std::min(d & ~7u, i + bounded_block);
+    for (; i < e; i += 8) {
+      __m256 qv = half_load_avx2(q + i);
+      for (int l = 0; l < 4; l++)
+        if (left[l])
+          acc[l] = float_step_avx2<true>(acc[l], qv, half_load_avx2(r[l] + i));
+    }
+    if (i + 8 > d) break;
+    for (int l = 0; l < 4; l++) partial[l] = hsum_avx2(acc[l]);
+    if (!bounded_rows_left(partial, bounds, left)) {
+      for (int l = 0; l < 4; l++) out[l] = partial[l];
+      return;
+    }
+  }
+  for (int l = 0; l < 4; l++)
+    out[l] = hsum_avx2(acc[l]) +
+             half_distance_scalar<true>(q + i, r[l] + i, d - i);
+}
+
+template <unsigned D = 0>
+TARGET_AVX512 void float_l2_rows4_bounded_avx512(const float* q,
+                                                 const float* const* r,
+                                                 unsigned d,
+                                                 const float* bounds,
+                                                 float* out) {
+  if (D) d = D;
+  __m512 acc[4] = {_mm512_setzero_ps(), _mm512_setzero_ps(),
+                   _mm512_setzero_ps(), _mm512_setzero_ps()};
+  bool left[4] = {true, true, true, true};
+  float partial[4];
+  for (unsigned i = 0; i < d;) {
+    unsigned e = std::min(d, i + bounded_block);
+    for (; i < e; i += 16) {
+      __mmask16 mask = tail_mask16(d - i);
+      __m512 qv = _mm512_maskz_loadu_ps(mask, q + i);
+      for (int l = 0; l < 4; l++)
+        if (left[l])
+          acc[l] = float_step_avx512<true>(
+              acc[l], qv, _mm512_maskz_loadu_ps(mask, r[l] + i));
+    }
+    if (i >= d) break;
+    for (int l = 0; l < 4; l++) partial[l] = _mm512_reduce_add_ps(acc[l]);
+    if (!bounded_rows_left(partial, bounds, left)) break;
+  }
+  for (int l = 0; l < 4; l++) out[l] = _mm512_reduce_add_ps(acc[l]);
+}
+
+template <typename H, unsigned D = 0>
+TARGET_AVX512 void half_l2_rows4_bounded_avx512(const H* q,
+                                                const H* const* r,
+                                                unsigned d,
+                                                const float* bounds,
+                                                float* out) {
+  if (D) d = D;
+  __m512 acc[4] = {_mm512_setzero_ps(), _mm512_setzero_ps(),
+                   _mm512_setzero_ps(), _mm512_setzero_ps()};
+  bool left[4] = {true, true, true, true};
+  float partial[4];
+  for (unsigned i = 0; i < d;) {
+    unsigned e = std::min(d, i + bounded_block);
+    for (; i < e; i += 16) {
+      __m512 qv = half_load_avx512(q + i, d - i);
+      for (int l = 0; l < 4; l++)
+        if (left[l])
+          acc[l] = float_step_avx512<true>(acc[l], qv,
+                                           half_load_avx512(r[l] + i, d - i));
+    }
+    if (i >= d) break;
+    for (int l = 0; l < 4; l++) partial[l] = _mm512_reduce_add_ps(acc[l]);
+    if (!bounded_rows_left(partial, bounds, left)) break;
+  }
+  for (int l = 0; l < 4; l++) out[l] = _mm512_reduce_add_ps(acc[l]);
+}
+
+// *************************************************************
+//  kernel table and runtime selection
+// *************************************************************
+
+enum DistanceISA {
+  ISA_SCALAR = 0,
+  ISA_SSE2 = 1,
+  ISA_AVX2 = 2,
+  ISA_AVX512 = 3,
+  ISA_AVX512_VNNI = 4
+};
+
+inline const char* isa_name(DistanceISA isa) {
+  static const char* names[] = {"scalar", "sse2", "avx2", "avx512",
+                                "avx512_vnni"};
+  return names[isa];
+}
+
+template <typename T>
+using pair_kernel = int (*)(const T*, const T*, unsigned);
+template <typename T>
+using rows4_kernel = void (*)(const T*, const T* const*, unsigned, float*);
+template <typename T>
+using half_kernel = float (*)(const T*, const T*, unsigned);
+template <typename T>
+using rows4_bounded_kernel = void (*)(const T*, const T* const*, unsigned,
+                                      const float*, float*);
+
+struct distance_kernel_table {
+  DistanceISA isa;
+  float (*float_l2)(const float*, const float*, unsigned);
+  float (*float_dot)(const float*, const float*, unsigned);
+  pair_kernel<uint8_t> uint8_l2, uint8_dot;
+  pair_kernel<int8_t> int8_l2, int8_dot;
+  rows4_kernel<float> float_l2_rows4, float_dot_rows4;
+  rows4_kernel<uint8_t> uint8_l2_rows4, uint8_dot_rows4;
+  rows4_kernel<int8_t> int8_l2_rows4, int8_dot_rows4;
+  half_kernel<float16> float16_l2, float16_dot;
+  half_kernel<bfloat16> bfloat16_l2, bfloat16_dot;
+  rows4_kernel<float16> float16_l2_rows4, float16_dot_rows4;
+  rows4_kernel<bfloat16> bfloat16_l2_rows4, bfloat16_dot_rows4;
+  pair_kernel<uint8_t> hamming;
+  rows4_bounded_kernel<float> float_l2_rows4_bounded;
+  rows4_bounded_kernel<float16> float16_l2_rows4_bounded;
+  rows4_bounded_kernel<bfloat16> bfloat16_l2_rows4_bounded;
+};
+
+// the highest level supported by both the CPU and the operating system
+inline DistanceISA detect_isa() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq"))
+    return __builtin_cpu_supports("avx512vnni") ? ISA_AVX512_VNNI : ISA_AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+      __builtin_cpu_supports("f16c"))
+    return ISA_AVX2;
+  if (__builtin_cpu_supports("sse2")) return ISA_SSE2;
+  return ISA_SCALAR;
+}
+
+// the detected level, capped by PARLAYANN_ISA
+inline DistanceISA selected_isa() {
+  DistanceISA isa = detect_isa();
+  if (const char* cap = std::getenv("PARLAYANN_ISA")) {
+    int i = 0;
+    while (i <= ISA_AVX512_VNNI && std::string(cap) != isa_name((DistanceISA)i))
+      i++;
+    if (i > ISA_AVX512_VNNI) {
+      std::cout << "Error: PARLAYANN_ISA should be scalar, sse2, avx2, avx512 "
+                   "or avx512_vnni"
+                << std::endl;
+      abort();
+    }
+    isa = std::min(isa, (DistanceISA)i);
+  }
+  return isa;
+}
+
+// The kernels of level isa, which the CPU must support.  AVX512_BF16 and
+// AVX512_VPOPCNTDQ are not implied by any level, so they replace the
+// bfloat16 dot products and the Hamming distances of the AVX-512 levels
+// where the CPU has them
+template <unsigned D = 0>
+inline distance_kernel_table distance_kernels_for(DistanceISA isa) {
+  static const distance_kernel_table tables[] = {
+      {ISA_SCALAR, float_distance_scalar<true, D>,
+       float_distance_scalar<false, D>, byte_distance_scalar<true, uint8_t, D>,
+       byte_distance_scalar<false, uint8_t, D>,
+       byte_distance_scalar<true, int8_t, D>,
+       byte_distance_scalar<false, int8_t, D>, float_rows4_scalar<true, D>,
+       float_rows4_scalar<false, D>, byte_rows4_scalar<true, uint8_t, D>,
+       byte_rows4_scalar<false, uint8_t, D>, byte_rows4_scalar<true, int8_t, D>,
+       byte_rows4_scalar<false, int8_t, D>,
+       half_distance_scalar<true, float16, D>,
+       half_distance_scalar<false, float16, D>,
+       half_distance_scalar<true, bfloat16, D>,
+       half_distance_scalar<false, bfloat16, D>,
+       half_rows4_scalar<true, float16, D>,
+       half_rows4_scalar<false, float16, D>,
+       half_rows4_scalar<true, bfloat16, D>,
+       half_rows4_scalar<false, bfloat16, D>, hamming_scalar,
+       float_l2_rows4_bounded_scalar<D>,
+       half_l2_rows4_bounded_scalar<float16, D>,
+       half_l2_rows4_bounded_scalar<bfloat16, D>},
+      {ISA_SSE2, float_distance_sse2<true, D>, float_distance_sse2<false, D>,
+       byte_distance_sse2<true, uint8_t, D>,
+       byte_distance_sse2<false, uint8_t, D>,
+       byte_distance_sse2<true, int8_t, D>,
+       byte_distance_sse2<false, int8_t, D>, float_rows4_sse2<true, D>,
+       float_rows4_sse2<false, D>, byte_rows4_sse2<true, uint8_t, D>,
+       byte_rows4_sse2<false, uint8_t, D>, byte_rows4_sse2<true, int8_t, D>,
+       byte_rows4_sse2<false, int8_t, D>,
+       half_distance_scalar<true, float16, D>,
+       half_distance_scalar<false, float16, D>,
+       half_distance_scalar<true, bfloat16, D>,
+       half_distance_scalar<false, bfloat16, D>,
+       half_rows4_scalar<true, float16, D>,
+       half_rows4_scalar<false, float16, D>,
+       half_rows4_scalar<true, bfloat16, D>,
+       half_rows4_scalar<false, bfloat16, D>, hamming_scalar,
+       float_l2_rows4_bounded_sse2<D>,
+       half_l2_rows4_bounded_scalar<float16, D>,
+       half_l2_rows4_bounded_scalar<bfloat16, D>},
+      {ISA_AVX2, float_distance_avx2<true, D>, float_distance_avx2<false, D>,
+       byte_l2_avx2<uint8_t, D>, byte_dot_avx2<uint8_t, D>,
+       byte_l2_avx2<int8_t, D>, byte_dot_avx2<int8_t, D>,
+       float_rows4_avx2<true, D>, float_rows4_avx2<false, D>,
+       byte_rows4_avx2<true, uint8_t, D>, byte_rows4_avx2<false, uint8_t, D>,
+       byte_rows4_avx2<true, int8_t, D>, byte_rows4_avx2<false, int8_t, D>,
+       half_distance_avx2<true, float16, D>,
+       half_distance_avx2<false, float16, D>,
+       half_distance_avx2<true, bfloat16, D>,
+       half_distance_avx2<false, bfloat16, D>,
+       half_rows4_avx2<true, float16, D>, half_rows4_avx2<false, float16, D>,
+       half_rows4_avx2<true, bfloat16, D>, half_rows4_avx2<false, bfloat16, D>,
+       hamming_popcnt, float_l2_rows4_bounded_avx2<D>,
+       half_l2_rows4_bounded_avx2<float16, D>,
+       half_l2_rows4_bounded_avx2<bfloat16, D>},
+      {ISA_AVX512, float_distance_avx512<true, D>,
+       float_distance_avx512<false, D>, byte_l2_avx512<uint8_t, D>,
+       byte_dot_avx512<uint8_t, D>, byte_l2_avx512<int8_t, D>,
+       byte_dot_avx512<int8_t, D>, float_rows4_avx512<true, D>,
+       float_rows4_avx512<false, D>, byte_rows4_avx512<true, uint8_t, D>,
+       byte_rows4_avx512<false, uint8_t, D>, byte_rows4_avx512<true, int8_t, D>,
+       byte_rows4_avx512<false, int8_t, D>,
+       half_distance_avx512<true, float16, D>,
+       half_distance_avx512<false, float16, D>,
+       half_distance_avx512<true, bfloat16, D>,
+       half_distance_avx512<false, bfloat16, D>,
+       half_rows4_avx512<true, float16, D>,
+       half_rows4_avx512<false, float16, D>,
+       half_rows4_avx512<true, bfloat16, D>,
+       half_rows4_avx512<false, bfloat16, D>, hamming_popcnt,
+       float_l2_rows4_bounded_avx512<D>,
+       half_l2_rows4_bounded_avx512<float16, D>,
+       half_l2_rows4_bounded_avx512<bfloat16, D>},
+      {ISA_AVX512_VNNI, float_distance_avx512<true, D>,
+       float_distance_avx512<false, D>, byte_l2_avx512_vnni<uint8_t, D>,
+       byte_dot_avx512_vnni<D>, byte_l2_avx512_vnni<int8_t, D>,
+       byte_dot_avx512_vnni<D>, float_rows4_avx512<true, D>,
+       float_rows4_avx512<false, D>, byte_rows4_avx512_vnni<true, uint8_t, D>,
+       byte_rows4_avx512_vnni<false, uint8_t, D>,
+       byte_rows4_avx512_vnni<true, int8_t, D>,
+       byte_rows4_avx512_vnni<false, int8_t, D>,
+       half_distance_avx512<true, float16, D>,
+       half_distance_avx512<false, float16, D>,
+       half_distance_avx512<true, bfloat16, D>,
+       half_distance_avx512<false, bfloat16, D>,
+       half_rows4_avx512<true, float16, D>,
+       half_rows4_avx512<false, float16, D>,
+       half_rows4_avx512<true, bfloat16, D>,
+       half_rows4_avx512<false, bfloat16, D>, hamming_popcnt,
+       float_l2_rows4_bounded_avx512<D>,
+       half_l2_rows4_bounded_avx512<float16, D>,
+       half_l2_rows4_bounded_avx512<bfloat16, D>}};
+
+  distance_kernel_table table = tables[isa];
+  if (table.isa >= ISA_AVX512 && __builtin_cpu_supports("avx512bf16")) {
+    table.bfloat16_dot = bfloat16_dot_avx512_bf16;
+    table.bfloat16_dot_rows4 = bfloat16_dot_rows4_avx512_bf16;
+  }
+  if (table.isa >= ISA_AVX512 && __builtin_cpu_supports("avx512vpopcntdq"))
+    table.hamming = hamming_avx512_vpopcntdq;
+  return table;
+}
+
+template <unsigned D = 0>
+inline distance_kernel_table select_distance_kernels() {
+  return distance_kernels_for<D>(selected_isa());
+}
+
+// probes the CPU on the first call
+template <unsigned D = 0>
+inline const distance_kernel_table& distance_kernels() {
+  static const distance_kernel_table table = select_distance_kernels<D>();
+  return table;
+}
+
+// *************************************************************
+//  one pair entry points
+// *************************************************************
+
+template <unsigned D = 0>
+inline float float_l2_distance(const float* p, const float* q, unsigned d) {
+  return distance_kernels<D>().float_l2(p, q, d);
+}
+template <unsigned D = 0>
+inline float float_dot_product(const float* p, const float* q, unsigned d) {
+  return distance_kernels<D>().float_dot(p, q, d);
+}
+template <unsigned D = 0>
+inline int byte_l2_distance(const uint8_t* p, const uint8_t* q, unsigned d) {
+  return distance_kernels<D>().uint8_l2(p, q, d);
+}
+template <unsigned D = 0>
+inline int byte_l2_distance(const int8_t* p, const int8_t* q, unsigned d) {
+  return distance_kernels<D>().int8_l2(p, q, d);
+}
+template <unsigned D = 0>
+inline int byte_dot_product(const uint8_t* p, const uint8_t* q, unsigned d) {
+  return distance_kernels<D>().uint8_dot(p, q, d);
+}
+template <unsigned D = 0>
+inline int byte_dot_product(const int8_t* p, const int8_t* q, unsigned d) {
+  return distance_kernels<D>().int8_dot(p, q, d);
+}
+inline int hamming_distance(const uint8_t* p, const uint8_t* q, unsigned d) {
+  return distance_kernels().hamming(p, q, d);
+}
+template <unsigned D = 0>
+inline float half_l2_distance(const float16* p, const float16* q,
+                              unsigned d) {
+  return distance_kernels<D>().float16_l2(p, q, d);
+}
+template <unsigned D = 0>
+inline float half_l2_distance(const bfloat16* p, const bfloat16* q,
+                              unsigned d) {
+  return distance_kernels<D>().bfloat16_l2(p, q, d);
+}
+template <unsigned D = 0>
+inline float half_dot_product(const float16* p, const float16* q,
+                              unsigned d) {
+  return distance_kernels<D>().float16_dot(p, q, d);
+}
+template <unsigned D = 0>
+inline float half_dot_product(const bfloat16* p, const bfloat16* q,
+                              unsigned d) {
+  return distance_kernels<D>().bfloat16_dot(p, q, d);
+}
+
+// *************************************************************
+//  batch entry points
+// *************************************************************
+
+template <unsigned D = 0>
+inline rows4_kernel<float> l2_rows4(const float*) {
+  return distance_kernels<D>().float_l2_rows4;
+}
+template <unsigned D = 0>
+inline rows4_kernel<uint8_t> l2_rows4(const uint8_t*) {
+  return distance_kernels<D>().uint8_l2_rows4;
+}
+template <unsigned D = 0>
+inline rows4_kernel<int8_t> l2_rows4(const int8_t*) {
+  return distance_kernels<D>().int8_l2_rows4;
+}
+template <unsigned D = 0>
+inline rows4_kernel<float16> l2_rows4(const float16*) {
+  return distance_kernels<D>().float16_l2_rows4;
+}
+template <unsigned D = 0>
+inline rows4_kernel<bfloat16> l2_rows4(const bfloat16*) {
+  return distance_kernels<D>().bfloat16_l2_rows4;
+}
+template <unsigned D = 0>
+inline rows4_kernel<float> dot_rows4(const float*) {
+  return distance_kernels<D>().float_dot_rows4;
+}
+template <unsigned D = 0>
+inline rows4_kernel<uint8_t> dot_rows4(const uint8_t*) {
+  return distance_kernels<D>().uint8_dot_rows4;
+}
+template <unsigned D = 0>
+inline rows4_kernel<int8_t> dot_rows4(const int8_t*) {
+  return distance_kernels<D>().int8_dot_rows4;
+}
+template <unsigned D = 0>
+inline rows4_kernel<float16> dot_rows4(const float16*) {
+  return distance_kernels<D>().float16_dot_rows4;
+}
+template <unsigned D = 0>
+inline rows4_kernel<bfloat16> dot_rows4(const bfloat16*) {
+  return distance_kernels<D>().bfloat16_dot_rows4;
+}
+
+template <unsigned D = 0>
+inline rows4_bounded_kernel<float> l2_rows4_bounded(const float*) {
+  return distance_kernels<D>().float_l2_rows4_bounded;
+}
+template <unsigned D = 0>
+inline rows4_bounded_kernel<float16> l2_rows4_bounded(const float16*) {
+  return distance_kernels<D>().float16_l2_rows4_bounded;
+}
+template <unsigned D = 0>
+inline rows4_bounded_kernel<bfloat16> l2_rows4_bounded(const bfloat16*) {
+  return distance_kernels<D>().bfloat16_l2_rows4_bounded;
+}
+
+// Prefetches every cache line of the d entries at row.  A row that does
+// not start on a line, such as those of a base file mapped in place (see
+// PointRange::map_points), touches one more line than its length in lines,
+// and so costs one more prefetch.
+template <typename T>
+inline void prefetch_row(const T* row, unsigned d) {
+  if (d == 0) return;
+  uintptr_t first = (uintptr_t)row & ~(uintptr_t)63;
+  uintptr_t last = (uintptr_t)(row + d) - 1;
+  for (uintptr_t a = first; a <= last; a += 64)
+    __builtin_prefetch((const char*)a);
+}
+
+// The distances from q to the rows base + ids[j] * stride, j < m, are
+// written to out[j], four rows at a time, prefetching the rows of the next
+// group.  A trailing partial group is padded by repeating its last row.
+template <typename T, typename indexType>
+void for_each_row_group(const T* q, const T* base, size_t stride,
+                        const indexType* ids, size_t m, unsigned d,
+                        float* out, rows4_kernel<T> rows4) {
+  size_t j = 0;
+  for (; j + 4 <= m; j += 4) {
+    for (size_t l = j + 4; l < std::min(j + 8, m); l++)
+      prefetch_row(base + ids[l] * stride, d);
+    const T* r[4] = {base + ids[j] * stride, base + ids[j + 1] * stride,
+                     base + ids[j + 2] * stride, base + ids[j + 3] * stride};
+    rows4(q, r, d, out + j);
+  }
+  if (j < m) {
+    const T* r[4];
+    float o[4];
+    for (size_t l = 0; l < 4; l++)
+      r[l] = base + ids[std::min(j + l, m - 1)] * stride;
+    rows4(q, r, d, o);
+    for (size_t l = 0; j + l < m; l++) out[j + l] = o[l];
+  }
+}
+
+template <unsigned D = 0, typename T, typename indexType>
+void euclidian_distance_batch(const T* q, const T* base, size_t stride,
+                              const indexType* ids, size_t m, unsigned d,
+                              float* out) {
+  for_each_row_group(q, base, stride, ids, m, d, out, l2_rows4<D>(q));
+}
+
+// The same distances, except that the distance to a row may stop early
+// once it is known to exceed bounds[j], at some value above bounds[j], see
+// bounded_block; out may be bounds.  Only the first block of the rows of
+// the next group is prefetched, since rows that stop early are not read
+// any further.  Rows no longer than a block cannot stop early, and byte
+// distances are exact and cheap, so these are computed in full.
+template <unsigned D = 0, typename T, typename indexType>
+void euclidian_distance_batch_bounded(const T* q, const T* base,
+                                      size_t stride, const indexType* ids,
+                                      size_t m, unsigned d,
+                                      const float* bounds, float* out) {
+  if (D) d = D;
+  if constexpr (std::is_integral<T>::value) {
+    euclidian_distance_batch<D>(q, base, stride, ids, m, d, out);
+  } else {
+    if (d <= bounded_block) {
+      euclidian_distance_batch<D>(q, base, stride, ids, m, d, out);
+      return;
+    }
+    rows4_bounded_kernel<T> rows4 = l2_rows4_bounded<D>(q);
+    unsigned ahead = std::min(d, bounded_block);
+    size_t j = 0;
+    for (; j + 4 <= m; j += 4) {
+      for (size_t l = j + 4; l < std::min(j + 8, m); l++)
+        prefetch_row(base + ids[l] * stride, ahead);
+      const T* r[4] = {base + ids[j] * stride, base + ids[j + 1] * stride,
+                       base + ids[j + 2] * stride, base + ids[j + 3] * stride};
+      float b[4] = {bounds[j], bounds[j + 1], bounds[j + 2], bounds[j + 3]};
+      rows4(q, r, d, b, out + j);
+    }
+    if (j < m) {
+      const T* r[4];
+      float b[4], o[4];
+      for (size_t l = 0; l < 4; l++) {
+        r[l] = base + ids[std::min(j + l, m - 1)] * stride;
+        b[l] = bounds[std::min(j + l, m - 1)];
+      }
+      rows4(q, r, d, b, o);
+      for (size_t l = 0; j + l < m; l++) out[j + l] = o[l];
+    }
+  }
+}
+
+// mips distances are negated dot products
+template <unsigned D = 0, typename T, typename indexType>
+void mips_distance_batch(const T* q, const T* base, size_t stride,
+                         const indexType* ids, size_t m, unsigned d,
+                         float* out) {
+  for_each_row_group(q, base, stride, ids, m, d, out, dot_rows4<D>(q));
+  for (size_t j = 0; j < m; j++) out[j] = -out[j];
+}
@@ -30,6 +30,7 @@
 #include "parlay/internal/file_map.h"
 #include "../bench/parse_command_line.h"
 #include "NSGDist.h"
+#include "distance_kernels.h"
 
 #include "../bench/parse_command_line.h"
 #include "types.h"
@@ -41,30 +42,34 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+template <unsigned D = 0>
 float euclidian_distance(const uint8_t *p, const uint8_t *q, unsigned d) {
-  int result = 0;
-  for (int i = 0; i < d; i++) {
-    result += ((int32_t)((int16_t)q[i] - (int16_t)p[i])) *
-      ((int32_t)((int16_t)q[i] - (int16_t)p[i]));
-  }
-  return (float)result;
+  return (float)byte_l2_distance<D>(p, q, d);
 }
 
+template <unsigned D = 0>
 float euclidian_distance(const int8_t *p, const int8_t *q, unsigned d) {
-  int result = 0;
-  for (int i = 0; i < d; i++) {
-    result += ((int32_t)((int16_t)q[i] - (int16_t)p[i])) *
-      ((int32_t)((int16_t)q[i] - (int16_t)p[i]));
-  }
-  return (float)result;
+  return (float)byte_l2_distance<D>(p, q, d);
 }
 
+template <unsigned D = 0>
 float euclidian_distance(const float *p, const float *q, unsigned d) {
-  efanna2e::DistanceL2 distfunc;
-  return distfunc.compare(p, q, d);
+  return float_l2_distance<D>(p, q, d);
+}
+
+template <unsigned D = 0>
+float euclidian_distance(const float16 *p, const float16 *q, unsigned d) {
+  return half_l2_distance<D>(p, q, d);
+}
+
+template <unsigned D = 0>
+float euclidian_distance(const bfloat16 *p, const bfloat16 *q, unsigned d) {
+  return half_l2_distance<D>(p, q, d);
 }
 
-template<typename T>
+// With D > 0 the dimension is fixed at compile time and the distances
+// use kernels specialized for it, see distance_kernels.h.
+template<typename T, unsigned D = 0>
 struct Euclidian_Point {
   using distanceType = float;
 
@@ -72,22 +77,37 @@ struct Euclidian_Point {
   static bool is_metric() {return true;}
   T operator[](long i){return *(values + i);}
 
-  float distance(Euclidian_Point<T> x) {
-    return euclidian_distance(this->values, x.values, d);
+  static constexpr unsigned fixed_dims = D;
+
+  float distance(Euclidian_Point<T, D> x) {
+    return euclidian_distance<D>(this->values, x.values, d);
   }
 
-  void prefetch() {
-    int l = (aligned_d * sizeof(T))/64;
-    for (int i=0; i < l; i++)
-      __builtin_prefetch((char*) values + i* 64);
+  // distances to the rows base + ids[j] * stride for j < m
+  template<typename indexType>
+  void distance_batch(const T* base, size_t stride, const indexType* ids,
+                      size_t m, float* out) {
+    euclidian_distance_batch<D>(values, base, stride, ids, m, d, out);
   }
 
+  // the same, except that the distance to a row may stop early, at some
+  // value above bounds[j], once it is known to exceed bounds[j]
+  template<typename indexType>
+  void distance_batch_bounded(const T* base, size_t stride,
+                              const indexType* ids, size_t m,
+                              const float* bounds, float* out) {
+    euclidian_distance_batch_bounded<D>(values, base, stride, ids, m, d,
+                                        bounds, out);
+  }
+
+  void prefetch() { prefetch_row(values, aligned_d); }
+
   long id() {return id_;}
 
   Euclidian_Point(const T* values, unsigned int d, unsigned int ad, long id)
     : values(values), d(d), aligned_d(ad), id_(id) {}
 
-  bool operator==(Euclidian_Point<T> q){
+  bool operator==(Euclidian_Point<T, D> q){
     for (int i = 0; i < d; i++) {
       if (values[i] != q.values[i]) {
         return false;
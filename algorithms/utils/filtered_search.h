@@ -0,0 +1,200 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "beamSearch.h"
+#include "graph.h"
+#include "labels.h"
+#include "stats.h"
+#include "types.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+
+// Beam search for the closest points to p among those for which
+// matches(id) holds.  The beam of width QP.beamSize traverses the graph
+// through every point, as beam_search does, so that regions of matching
+// points can be reached through points that do not match.  Alongside it
+// the closest QP.beamSize matching points with a computed distance are
+// kept as the results, whether or not they made the beam, and the cut
+// prunes the beam relative to the k-th closest match rather than the
+// k-th entry of the beam.  With only_matching the beam admits matching
+// points only, as in Filtered-DiskANN, which is much faster on graphs
+// built for filters (see knn_index in vamana/index.h), whose subgraph of
+// each label is navigable, but gets lost on other graphs.  Returns views
+// of the results and the visited set, which live in ctx, and the number
+// of distance comparisons.
+template<typename Point, typename PointRange, typename indexType,
+         typename Filter, typename GraphType = Graph<indexType>>
+auto filtered_beam_search(Point p, GraphType &G, PointRange &Points,
+                          parlay::slice<indexType*, indexType*> starting_points,
+                          Filter &&matches, QueryParams &QP,
+                          beam_search_context<indexType, typename Point::distanceType> &ctx,
+                          bool only_matching = false) {
+  using distanceType = typename Point::distanceType;
+  using pid = std::pair<indexType, distanceType>;
+  auto less = [](pid a, pid b) {
+    return a.second < b.second || (a.second == b.second && a.first < b.first);
+  };
+  int bits = std::max<int>(10, std::ceil(std::log2(QP.beamSize * QP.beamSize)) - 2);
+  ctx.reset(bits, QP.beamSize, G.max_degree(), choose_visited_mode(QP, G.size()),
+            G.size());
+  std::vector<pid> &frontier = ctx.frontier;
+  std::vector<pid> &new_frontier = ctx.new_frontier;
+  std::vector<pid> &candidates = ctx.candidates;
+  std::vector<pid> &results = ctx.results;
+  std::vector<pid> &new_results = ctx.new_results;
+  std::vector<pid> &result_candidates = ctx.result_candidates;
+  std::vector<indexType> &keep = ctx.keep;
+  std::vector<distanceType> &keep_dists = ctx.keep_dists;
+  results.clear();
+  result_candidates.clear();
+  if (new_results.size() < QP.beamSize + G.max_degree())
+    new_results.resize(QP.beamSize + G.max_degree());
+
+  size_t dist_cmps = starting_points.size();
+  for (auto q : starting_points) {
+    ctx.has_been_seen(q);
+    pid x(q, Points[q].distance(p));
+    frontier.push_back(x);
+    if (matches(q)) results.push_back(x);
+  }
+  std::sort(frontier.begin(), frontier.end(), less);
+  std::sort(results.begin(), results.end(), less);
+  ctx.unvisited_frontier[0] = frontier[0];
+  distanceType inf = std::numeric_limits<distanceType>::max();
+
+  int remain = 1;
+  int num_visited = 0;
+  while (remain > 0 && num_visited < QP.limit) {
+    pid current = ctx.unvisited_frontier[0];
+    ctx.visited.insert(
+        std::upper_bound(ctx.visited.begin(), ctx.visited.end(), current, less),
+        current);
+    num_visited++;
+
+    keep.clear();
+    long num_elts = std::min<long>(G[current.first].size(), QP.degree_limit);
+    for (indexType i = 0; i < num_elts; i++) {
+      auto a = G[current.first][i];
+      if (a == p.id() || ctx.has_been_seen(a)) continue;
+      keep.push_back(a);
+      Points[a].prefetch();
+    }
+
+    // a neighbor is of use if it beats the worst entry of the beam, or if
+    // it matches and beats the worst result, so once both are full the
+    // distances can stop past the larger of the two
+    distanceType beam_cutoff =
+        frontier.size() < QP.beamSize ? inf : frontier[frontier.size() - 1].second;
+    distanceType result_cutoff =
+        results.size() < QP.beamSize ? inf : results[results.size() - 1].second;
+    distanceType cutoff = std::max(beam_cutoff, result_cutoff);
+    if (cutoff == inf) {
+      Points.distance_batch(p, keep.data(), keep.size(), keep_dists.data());
+    } else {
+      std::fill(keep_dists.begin(), keep_dists.begin() + keep.size(), cutoff);
+      Points.distance_batch_bounded(p, keep.data(), keep.size(),
+                                    keep_dists.data(), keep_dists.data());
+    }
+    dist_cmps += keep.size();
+    candidates.clear();
+    result_candidates.clear();
+    for (size_t j = 0; j < keep.size(); j++) {
+      if (keep_dists[j] < beam_cutoff && (!only_matching || matches(keep[j])))
+        candidates.push_back(std::pair{keep[j], keep_dists[j]});
+      if (keep_dists[j] < result_cutoff && matches(keep[j]))
+        result_candidates.push_back(std::pair{keep[j], keep_dists[j]});
+    }
+
+    std::sort(result_candidates.begin(), result_candidates.end(), less);
+    size_t new_results_size =
+        std::set_union(results.begin(), results.end(), result_candidates.begin(),
+                       result_candidates.end(), new_results.begin(), less) -
+        new_results.begin();
+    new_results_size = std::min<size_t>(QP.beamSize, new_results_size);
+    results.assign(new_results.begin(), new_results.begin() + new_results_size);
+
+    std::sort(candidates.begin(), candidates.end(), less);
+    size_t new_frontier_size =
+        std::set_union(frontier.begin(), frontier.end(), candidates.begin(),
+                       candidates.end(), new_frontier.begin(), less) -
+        new_frontier.begin();
+    new_frontier_size = std::min<size_t>(QP.beamSize, new_frontier_size);
+    if (QP.k > 0 && results.size() > QP.k && Points[0].is_metric())
+      new_frontier_size =
+          (std::upper_bound(new_frontier.begin(),
+                            new_frontier.begin() + new_frontier_size,
+                            std::pair{0, QP.cut * results[QP.k].second}, less) -
+           new_frontier.begin());
+    frontier.assign(new_frontier.begin(), new_frontier.begin() + new_frontier_size);
+
+    remain =
+        std::set_difference(frontier.begin(), frontier.end(), ctx.visited.begin(),
+                            ctx.visited.end(), ctx.unvisited_frontier.begin(), less) -
+        ctx.unvisited_frontier.begin();
+  }
+  return std::make_pair(
+      std::make_pair(parlay::make_slice(results.data(), results.data() + results.size()),
+                     parlay::make_slice(ctx.visited.data(), ctx.visited.data() + ctx.visited.size())),
+      dist_cmps);
+}
+
+// filtered_beam_search for every query, for the base points that have all
+// of the query's labels, starting from the start points of its labels
+// (see label_start_points).  Queries with fewer than QP.k matches found
+// are padded with -1.
+template<typename Point, typename PointRange, typename indexType>
+parlay::sequence<parlay::sequence<indexType>> searchAllFiltered(
+    PointRange &Query_Points, Graph<indexType> &G, PointRange &Base_Points,
+    stats<indexType> &QueryStats, PointLabels<indexType> &Base_Labels,
+    PointLabels<indexType> &Query_Labels, parlay::sequence<indexType> &label_starts,
+    indexType start_point, QueryParams &QP, bool only_matching = false) {
+  if (QP.k > QP.beamSize) {
+    std::cout << "Error: beam search parameter Q = " << QP.beamSize
+              << " same size or smaller than k = " << QP.k << std::endl;
+    abort();
+  }
+  parlay::sequence<parlay::sequence<indexType>> all_neighbors(Query_Points.size());
+  parlay::parallel_for(0, Query_Points.size(), [&](size_t i) {
+    auto &ctx = local_search_context<indexType, typename Point::distanceType>();
+    auto query = Query_Labels[i];
+    auto starts = filter_start_points(query, label_starts, start_point, QP.beamSize);
+    auto [pairElts, dist_cmps] = filtered_beam_search(
+        Query_Points[i], G, Base_Points, parlay::make_slice(starts),
+        [&](indexType a) { return Base_Labels.matches(a, query); }, QP, ctx,
+        only_matching);
+    auto [results, visitedElts] = pairElts;
+    parlay::sequence<indexType> neighbors(QP.k, (indexType)-1);
+    for (size_t j = 0; j < std::min<size_t>(QP.k, results.size()); j++)
+      neighbors[j] = results[j].first;
+    all_neighbors[i] = neighbors;
+    QueryStats.increment_visited(i, visitedElts.size());
+    QueryStats.increment_dist(i, dist_cmps);
+  });
+  return all_neighbors;
+}
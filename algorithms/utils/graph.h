@@ -29,7 +29,11 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include "../bench/parse_command_line.h"
 #include "NSGDist.h"
@@ -37,6 +41,7 @@
 #include "parlay/parallel.h"
 #include "parlay/primitives.h"
 #include "types.h"
+#include "parallel_io.h"
 
 template <typename indexType>
 struct edgeRange {
@@ -131,67 +136,65 @@ struct edgeRange {
   indexType id_;
 };
 
+// The padded graph format stores the rows exactly as they are laid out in
+// memory, n rows of maxDeg + 1 entries holding a degree followed by the
+// neighbors and unused slots, after a header of one page.  Such a file is
+// mapped directly instead of being read and scattered; the mapping is
+// private, so changes to the graph never reach the file.  Graph(char*)
+// also reads the compact format written by save(), which stores the degrees
+// and then the neighbor lists back to back.
+//
+// Both formats also hold the vertex searches start from, see start_point():
+// the padded header has a field for it, and the compact format has it as
+// one more index after the neighbor lists, which files written before are
+// simply without (their start point is 0).  Padded files of version 1 leave
+// the field 0, so their start point is 0 as well; versions newer than
+// PADDED_GRAPH_VERSION are rejected rather than mapped with this layout.
+constexpr uint64_t PADDED_GRAPH_MAGIC = 0x485052474e4e4150;  // "PANNGRPH"
+constexpr uint32_t PADDED_GRAPH_VERSION = 2;
+constexpr size_t PADDED_GRAPH_HEADER_BYTES = 4096;
+
+struct padded_graph_header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t index_bytes;
+  uint64_t n;
+  uint64_t max_degree;
+  uint64_t start_point;
+};
+
 template <typename indexType>
 struct Graph {
   long max_degree() { return maxDeg; }
   size_t size() { return n; }
 
+  // the vertex searches start from, chosen by the algorithm that built the
+  // graph and saved with it
+  indexType start_point() { return start; }
+  void set_start_point(indexType s) { start = s; }
+
   Graph() {}
 
   Graph(long maxDeg, size_t n) : maxDeg(maxDeg), n(n) {
-    graph = parlay::sequence<indexType>(n * (maxDeg + 1), 0);
+    size_t row = maxDeg + 1;
+    graph = std::shared_ptr<indexType[]>(
+        (indexType*)aligned_alloc(64, n * row * sizeof(indexType)), std::free);
+    parlay::parallel_for(0, n, [&](size_t i) {
+      std::fill(graph.get() + i * row, graph.get() + (i + 1) * row, 0);
+    });
   }
 
-  Graph(char* gFile) {
-    std::ifstream reader(gFile);
-    assert(reader.is_open());
-
-    // read num points and max degree
-    indexType num_points;
-    indexType max_deg;
-    reader.read((char*)(&num_points), sizeof(indexType));
-    n = num_points;
-    reader.read((char*)(&max_deg), sizeof(indexType));
-    maxDeg = max_deg;
-    std::cout << "Detected " << num_points << " points with max degree "
-              << max_deg << std::endl;
-
-    // read degrees and perform scan to find offsets
-    indexType* degrees_start = new indexType[n];
-    reader.read((char*)(degrees_start), sizeof(indexType) * n);
-    indexType* degrees_end = degrees_start + n;
-    parlay::slice<indexType*, indexType*> degrees =
-        parlay::make_slice(degrees_start, degrees_end);
-    auto [offsets, total] = parlay::scan(degrees);
-    offsets.push_back(total);
-
-    // write to graph object
-    graph = parlay::sequence<indexType>(n * (maxDeg + 1), 0);
-    // write 1000000 vertices at a time
-    size_t BLOCK_SIZE = 1000000;
-    size_t index = 0;
-    size_t total_size_read = 0;
-    while (index < n) {
-      size_t g_floor = index;
-      size_t g_ceiling = g_floor + BLOCK_SIZE <= n ? g_floor + BLOCK_SIZE : n;
-      size_t total_size_to_read = offsets[g_ceiling] - offsets[g_floor];
-      indexType* edges_start = new indexType[total_size_to_read];
-      reader.read((char*)(edges_start), sizeof(indexType) * total_size_to_read);
-      indexType* edges_end = edges_start + total_size_to_read;
-      parlay::slice<indexType*, indexType*> edges =
-          parlay::make_slice(edges_start, edges_end);
-      parlay::parallel_for(g_floor, g_ceiling, [&](size_t i) {
-        graph[i * (maxDeg + 1)] = degrees[i];
-        for (size_t j = 0; j < degrees[i]; j++) {
-          graph[i * (maxDeg + 1) + 1 + j] =
-              edges[offsets[i] - total_size_read + j];
-        }
-      });
-      total_size_read += total_size_to_read;
-      index = g_ceiling;
-      delete[] edges_start;
-    }
-    delete[] degrees_start;
+  // populate prefaults a padded graph file when it is mapped, and
+  // huge_pages asks the kernel to back the mapping with huge pages
+  Graph(char* gFile, bool populate = false, bool huge_pages = false) {
+    padded_graph_header header = {};
+    parallel_file reader(gFile, false);
+    if (reader.size() >= sizeof(header))
+      reader.read(&header, sizeof(header), 0);
+    if (header.magic == PADDED_GRAPH_MAGIC)
+      map_padded(gFile, header, populate, huge_pages);
+    else
+      read_compact(reader);
   }
 
   void save(char* oFile) {
@@ -201,10 +204,15 @@ struct Graph {
                                             static_cast<indexType>(maxDeg)};
     parlay::sequence<indexType> sizes = parlay::tabulate(
         n, [&](size_t i) { return static_cast<indexType>((*this)[i].size()); });
-    std::ofstream writer;
-    writer.open(oFile, std::ios::binary | std::ios::out);
-    writer.write((char*)preamble.begin(), 2 * sizeof(indexType));
-    writer.write((char*)sizes.begin(), sizes.size() * sizeof(indexType));
+    auto [offsets, total] = parlay::scan(
+        parlay::map(sizes, [](indexType d) { return static_cast<size_t>(d); }));
+    parallel_file writer(oFile, true);
+    writer.write(preamble.begin(), 2 * sizeof(indexType), 0);
+    writer.write(sizes.begin(), sizes.size() * sizeof(indexType),
+                 2 * sizeof(indexType));
+    size_t edges_offset = (2 + n) * sizeof(indexType);
+    writer.write(&start, sizeof(indexType),
+                 edges_offset + total * sizeof(indexType));
     size_t BLOCK_SIZE = 1000000;
     size_t index = 0;
     while (index < n) {
@@ -217,19 +225,155 @@ struct Graph {
             });
           });
       parlay::sequence<indexType> data = parlay::flatten(edge_data);
-      writer.write((char*)data.begin(), data.size() * sizeof(indexType));
+      writer.write(data.begin(), data.size() * sizeof(indexType),
+                   edges_offset + offsets[floor] * sizeof(indexType));
       index = ceiling;
     }
-    writer.close();
+    writer.report();
+  }
+
+  // writes the padded format, which can be mapped by Graph(char*)
+  void save_padded(char* oFile) {
+    std::cout << "Writing padded graph with " << n << " points and max degree "
+              << maxDeg << std::endl;
+    std::vector<char> preamble(PADDED_GRAPH_HEADER_BYTES, 0);
+    padded_graph_header header = {PADDED_GRAPH_MAGIC, PADDED_GRAPH_VERSION,
+                                  sizeof(indexType), n,
+                                  static_cast<uint64_t>(maxDeg), start};
+    std::memcpy(preamble.data(), &header, sizeof(header));
+    parallel_file writer(oFile, true);
+    writer.write(preamble.data(), preamble.size(), 0);
+    writer.write(graph.get(), n * (maxDeg + 1) * sizeof(indexType),
+                 PADDED_GRAPH_HEADER_BYTES);
+    writer.report();
+  }
+
+  // the graph with vertex order[i] renamed to i, see reorder.h
+  Graph permute(const parlay::sequence<indexType>& order) {
+    parlay::sequence<indexType> new_id(n);
+    parlay::parallel_for(0, n, [&](size_t i) { new_id[order[i]] = i; });
+    Graph P(maxDeg, n);
+    P.start = new_id[start];
+    parlay::parallel_for(0, n, [&](size_t i) {
+      auto nbhs = (*this)[order[i]];
+      P[i].update_neighbors(parlay::tabulate(
+          nbhs.size(), [&](size_t j) { return new_id[nbhs[j]]; }));
+    });
+    return P;
   }
 
   edgeRange<indexType> operator[](indexType i) {
-    return edgeRange<indexType>(graph.begin() + i * (maxDeg + 1),
-                                graph.begin() + (i + 1) * (maxDeg + 1), i);
+    return edgeRange<indexType>(graph.get() + i * (maxDeg + 1),
+                                graph.get() + (i + 1) * (maxDeg + 1), i);
   }
 
  private:
   size_t n;
   long maxDeg;
-  parlay::sequence<indexType> graph;
+  indexType start = 0;
+  std::shared_ptr<indexType[]> graph;
+
+  // a start point read from a file must be a vertex of the graph (or 0,
+  // the default, for an empty one)
+  void check_start_point(uint64_t s) {
+    if (s != 0 && s >= n) {
+      std::cout << "ERROR: graph file has start point " << s
+                << ", expected less than " << n << std::endl;
+      abort();
+    }
+  }
+
+  void read_compact(parallel_file& reader) {
+    // read num points and max degree
+    indexType preamble[2];
+    reader.read(preamble, 2 * sizeof(indexType), 0);
+    n = preamble[0];
+    maxDeg = preamble[1];
+    std::cout << "Detected " << n << " points with max degree " << maxDeg
+              << std::endl;
+
+    // read degrees and perform scan to find offsets
+    parlay::sequence<indexType> degrees(n);
+    reader.read(degrees.begin(), n * sizeof(indexType),
+                2 * sizeof(indexType));
+    auto [offsets, total] = parlay::scan(parlay::map(
+        degrees, [](indexType d) { return static_cast<size_t>(d); }));
+    offsets.push_back(total);
+
+    // write to graph object
+    *this = Graph(maxDeg, n);
+    // read the edges of 1000000 vertices at a time
+    size_t edges_offset = (2 + n) * sizeof(indexType);
+    size_t BLOCK_SIZE = 1000000;
+    size_t index = 0;
+    while (index < n) {
+      size_t g_floor = index;
+      size_t g_ceiling = g_floor + BLOCK_SIZE <= n ? g_floor + BLOCK_SIZE : n;
+      size_t total_size_to_read = offsets[g_ceiling] - offsets[g_floor];
+      parlay::sequence<indexType> edges(total_size_to_read);
+      reader.read(edges.begin(), sizeof(indexType) * total_size_to_read,
+                  edges_offset + offsets[g_floor] * sizeof(indexType));
+      parlay::parallel_for(g_floor, g_ceiling, [&](size_t i) {
+        graph[i * (maxDeg + 1)] = degrees[i];
+        for (size_t j = 0; j < degrees[i]; j++) {
+          graph[i * (maxDeg + 1) + 1 + j] =
+              edges[offsets[i] - offsets[g_floor] + j];
+        }
+      });
+      index = g_ceiling;
+    }
+    if (reader.size() > edges_offset + total * sizeof(indexType))
+      reader.read(&start, sizeof(indexType),
+                  edges_offset + total * sizeof(indexType));
+    check_start_point(start);
+    reader.report();
+  }
+
+  void map_padded(char* gFile, padded_graph_header header, bool populate,
+                  bool huge_pages) {
+    if (header.version == 0 || header.version > PADDED_GRAPH_VERSION) {
+      std::cout << "ERROR: graph file has padded format version "
+                << header.version << ", expected 1 to "
+                << PADDED_GRAPH_VERSION << std::endl;
+      abort();
+    }
+    if (header.index_bytes != sizeof(indexType)) {
+      std::cout << "ERROR: graph file has " << header.index_bytes
+                << "-byte indices, expected " << sizeof(indexType)
+                << std::endl;
+      abort();
+    }
+    n = header.n;
+    maxDeg = header.max_degree;
+    check_start_point(header.start_point);
+    start = header.start_point;
+    std::cout << "Detected " << n << " points with max degree " << maxDeg
+              << " (padded)" << std::endl;
+    size_t length =
+        PADDED_GRAPH_HEADER_BYTES + n * (maxDeg + 1) * sizeof(indexType);
+
+    int fd = open(gFile, O_RDONLY);
+    struct stat sb;
+    if (fd == -1 || fstat(fd, &sb) == -1) {
+      perror("open");
+      exit(-1);
+    }
+    if ((size_t)sb.st_size != length) {
+      std::cout << "ERROR: graph file has " << sb.st_size
+                << " bytes, expected " << length << std::endl;
+      abort();
+    }
+    int flags = MAP_PRIVATE | (populate ? MAP_POPULATE : 0);
+    char* p = static_cast<char*>(
+        mmap(0, length, PROT_READ | PROT_WRITE, flags, fd, 0));
+    if (p == MAP_FAILED) {
+      perror("mmap");
+      exit(-1);
+    }
+    close(fd);
+    if (huge_pages) madvise(p, length, MADV_HUGEPAGE);
+    graph = std::shared_ptr<indexType[]>(
+        (indexType*)(p + PADDED_GRAPH_HEADER_BYTES),
+        [p, length](indexType*) { munmap(p, length); });
+  }
 };
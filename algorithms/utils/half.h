@@ -0,0 +1,109 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// 16 bit floating point coordinates.  float16 is IEEE binary16 (5
+// exponent and 10 mantissa bits), bfloat16 the upper half of a float (8
+// exponent and 7 mantissa bits), which keeps the range of float at less
+// precision.  Both convert to and from float implicitly, rounding to
+// nearest even, so that code written for float coordinates reads them
+// unchanged; the distance kernels convert whole vectors with F16C and
+// AVX-512 instead, see distance_kernels.h.
+
+inline float half_to_float(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1F, man = h & 0x3FF;
+  uint32_t bits;
+  if (exp == 0x1F) {
+    bits = sign | 0x7F800000 | (man << 13);
+  } else if (exp != 0) {
+    bits = sign | ((exp + 112) << 23) | (man << 13);
+  } else {
+    // zero or subnormal, man * 2^-24
+    float f = (float)man * (1.0f / 16777216.0f);
+    std::memcpy(&bits, &f, sizeof(bits));
+    bits |= sign;
+  }
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+inline uint16_t float_to_half(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  uint16_t sign = (x >> 16) & 0x8000;
+  uint32_t ax = x & 0x7FFFFFFF;
+  if (ax >= 0x7F800000) return sign | 0x7C00 | (ax > 0x7F800000 ? 0x200 : 0);
+  // 65520 and above round to infinity
+  if (ax >= 0x477FF000) return sign | 0x7C00;
+  if (ax < 0x38800000) {
+    // below 2^-14 the result is subnormal: adding 0.5 leaves the value in
+    // units of 2^-24, rounded to nearest even, in the low mantissa bits
+    float a;
+    std::memcpy(&a, &ax, sizeof(a));
+    a += 0.5f;
+    uint32_t r;
+    std::memcpy(&r, &a, sizeof(r));
+    return sign | (uint16_t)(r - 0x3F000000);
+  }
+  // rebias the exponent and round the 13 dropped bits to nearest even
+  ax += 0xC8000FFF + ((ax >> 13) & 1);
+  return sign | (uint16_t)(ax >> 13);
+}
+
+inline float bfloat16_to_float(uint16_t h) {
+  uint32_t bits = (uint32_t)h << 16;
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+inline uint16_t float_to_bfloat16(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  if ((x & 0x7FFFFFFF) > 0x7F800000) return (x >> 16) | 0x40;
+  return (x + 0x7FFF + ((x >> 16) & 1)) >> 16;
+}
+
+struct float16 {
+  uint16_t bits;
+
+  float16() = default;
+  float16(float f) : bits(float_to_half(f)) {}
+  operator float() const { return half_to_float(bits); }
+};
+
+struct bfloat16 {
+  uint16_t bits;
+
+  bfloat16() = default;
+  bfloat16(float f) : bits(float_to_bfloat16(f)) {}
+  operator float() const { return bfloat16_to_float(bits); }
+};
+
+static_assert(sizeof(float16) == 2 && sizeof(bfloat16) == 2,
+              "16 bit coordinates are packed");
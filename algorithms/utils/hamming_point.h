@@ -0,0 +1,72 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "distance_kernels.h"
+
+// Binary vectors packed 8 bits to a byte, stored in a
+// PointRange<uint8_t, Hamming_Point> whose dimension is the number of
+// bytes.  The distance is the number of bits that differ, counted on 64
+// bit words with popcnt or vpopcntq (see distance_kernels.h).
+struct Hamming_Point {
+  using distanceType = float;
+
+  static distanceType d_min() { return 0; }
+  static bool is_metric() { return true; }
+  uint8_t operator[](long i) { return *(values + i); }
+
+  float distance(Hamming_Point x) {
+    return (float)hamming_distance(values, x.values, d);
+  }
+
+  // distances to the rows base + ids[j] * stride for j < m
+  template <typename indexType>
+  void distance_batch(const uint8_t* base, size_t stride,
+                      const indexType* ids, size_t m, float* out) {
+    for (size_t j = 0; j < m; j++) {
+      if (j + 4 < m) prefetch_row(base + ids[j + 4] * stride, d);
+      out[j] = (float)hamming_distance(values, base + ids[j] * stride, d);
+    }
+  }
+
+  void prefetch() { prefetch_row(values, aligned_d); }
+
+  long id() { return id_; }
+
+  Hamming_Point(const uint8_t* values, unsigned int d, unsigned int ad,
+                long id)
+      : values(values), d(d), aligned_d(ad), id_(id) {}
+
+  bool operator==(Hamming_Point q) {
+    return std::memcmp(values, q.values, d) == 0;
+  }
+
+ private:
+  const uint8_t* values;
+  unsigned int d;
+  unsigned int aligned_d;
+  long id_;
+};
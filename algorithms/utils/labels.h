@@ -0,0 +1,213 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <sys/mman.h>
+
+#include "medoid.h"
+#include "mmap.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+
+// The labels of a set of points, for filtered searches: a sorted list of
+// integer labels per point, stored row after row.  Read from the sparse
+// matrix format of the filter track of big-ann-benchmarks (.spmat): the
+// number of rows, columns and nonzeros as 64 bit integers, the nrow + 1
+// row offsets as 64 bit integers, the column of each nonzero as a 32 bit
+// integer and its value as a float, which is ignored.  Column j of row i
+// is label j of point i.  A query matches the points that have every one
+// of its labels.
+template<typename indexType>
+struct PointLabels {
+  size_t n = 0;
+  size_t num_labels = 0;
+  parlay::sequence<size_t> offsets;
+  parlay::sequence<indexType> labels;
+
+  PointLabels() {}
+
+  PointLabels(char* filename) {
+    if (filename == NULL) return;
+    auto [fileptr, length] = mmapStringFromFile(filename);
+    int64_t* header = (int64_t*)fileptr;
+    if (length < 3 * sizeof(int64_t)) {
+      std::cout << "ERROR: " << filename << " is not a label file" << std::endl;
+      abort();
+    }
+    n = header[0];
+    num_labels = header[1];
+    size_t nnz = header[2];
+    if (length != 3 * sizeof(int64_t) + (n + 1) * sizeof(int64_t) +
+                      nnz * (sizeof(int32_t) + sizeof(float))) {
+      std::cout << "ERROR: " << filename << " is not a label file" << std::endl;
+      abort();
+    }
+    int64_t* indptr = header + 3;
+    int32_t* indices = (int32_t*)(indptr + n + 1);
+    offsets = parlay::tabulate(n + 1, [&](size_t i) { return (size_t)indptr[i]; });
+    labels = parlay::tabulate(nnz, [&](size_t j) { return (indexType)indices[j]; });
+    parlay::parallel_for(0, n, [&](size_t i) {
+      std::sort(labels.begin() + offsets[i], labels.begin() + offsets[i + 1]);
+    });
+    munmap(fileptr, length);
+    if (parlay::count_if(labels, [&](indexType l) { return l >= num_labels; }) > 0) {
+      std::cout << "ERROR: " << filename << " has labels past its " << num_labels
+                << " columns" << std::endl;
+      abort();
+    }
+    std::cout << "Detected " << n << " points with " << nnz << " labels out of "
+              << num_labels << std::endl;
+  }
+
+  size_t size() { return n; }
+
+  // the labels of point i, in increasing order
+  parlay::slice<indexType*, indexType*> operator[](size_t i) {
+    return parlay::make_slice(labels.begin() + offsets[i],
+                              labels.begin() + offsets[i + 1]);
+  }
+
+  bool has(size_t i, indexType label) {
+    return std::binary_search(labels.begin() + offsets[i],
+                              labels.begin() + offsets[i + 1], label);
+  }
+
+  // whether point i has every label in query
+  template<typename Labels>
+  bool matches(size_t i, Labels&& query) {
+    for (indexType l : query)
+      if (!has(i, l)) return false;
+    return true;
+  }
+
+  // whether a and b share a label
+  bool intersects(size_t a, size_t b) {
+    auto A = (*this)[a];
+    auto B = (*this)[b];
+    auto i = A.begin();
+    auto j = B.begin();
+    while (i != A.end() && j != B.end()) {
+      if (*i < *j) i++;
+      else if (*j < *i) j++;
+      else return true;
+    }
+    return false;
+  }
+
+  // whether c has every label that a and b share, so that an edge from a
+  // to c can stand in for the edge from a to b in each label's subgraph
+  bool covers(size_t c, size_t a, size_t b) {
+    auto A = (*this)[a];
+    auto B = (*this)[b];
+    auto i = A.begin();
+    auto j = B.begin();
+    while (i != A.end() && j != B.end()) {
+      if (*i < *j) i++;
+      else if (*j < *i) j++;
+      else {
+        if (!has(c, *i)) return false;
+        i++;
+        j++;
+      }
+    }
+    return true;
+  }
+
+  // the labels in a new order of the points, where point i is point
+  // order[i] of this, such as the order of a graph written by reorder_graph
+  PointLabels<indexType> permute(const parlay::sequence<indexType>& order) {
+    PointLabels<indexType> P;
+    P.n = order.size();
+    P.num_labels = num_labels;
+    auto sizes = parlay::tabulate(P.n, [&](size_t i) {
+      return offsets[order[i] + 1] - offsets[order[i]];
+    });
+    auto [starts, total] = parlay::scan(sizes);
+    P.offsets = parlay::append(starts, parlay::sequence<size_t>(1, total));
+    P.labels = parlay::sequence<indexType>(total);
+    parlay::parallel_for(0, P.n, [&](size_t i) {
+      std::copy(labels.begin() + offsets[order[i]],
+                labels.begin() + offsets[order[i] + 1],
+                P.labels.begin() + P.offsets[i]);
+    });
+    return P;
+  }
+
+  // the points with each label, in increasing order
+  parlay::sequence<parlay::sequence<indexType>> points_by_label() {
+    auto pairs = parlay::flatten(parlay::tabulate(n, [&](size_t i) {
+      return parlay::map((*this)[i], [&](indexType l) {
+        return std::make_pair(l, (indexType)i);
+      });
+    }));
+    parlay::sort_inplace(pairs);
+    // the first pair of each label, and of the label after it
+    parlay::sequence<size_t> first(num_labels + 1, pairs.size());
+    parlay::parallel_for(0, pairs.size(), [&](size_t j) {
+      if (j == 0 || pairs[j].first != pairs[j - 1].first)
+        first[pairs[j].first] = j;
+    });
+    for (size_t l = num_labels; l > 0; l--)
+      first[l - 1] = std::min(first[l - 1], first[l]);
+    auto grouped = parlay::tabulate(num_labels, [&](size_t l) {
+      return parlay::tabulate(first[l + 1] - first[l], [&](size_t j) {
+        return pairs[first[l] + j].second;
+      });
+    });
+    return grouped;
+  }
+};
+
+// A start point for each label, an approximate medoid of the points that
+// have it, so that a filtered search starts among the points that match
+// it.  Labels that no point has start at default_start.
+template<typename PointRange, typename indexType>
+parlay::sequence<indexType> label_start_points(PointLabels<indexType>& L,
+                                               PointRange& Points,
+                                               indexType default_start) {
+  auto by_label = L.points_by_label();
+  return parlay::tabulate(by_label.size(), [&](size_t l) {
+    auto& ids = by_label[l];
+    if (ids.size() == 0) return default_start;
+    return approximate_medoid_of<PointRange, indexType>(
+        Points, ids.size(), [&](size_t i) { return ids[i]; }, 1000);
+  }, 1);
+}
+
+// the start points of a search for the points with every label in query:
+// the start points of at most max_starts of its labels, or default_start
+// without labels
+template<typename Labels, typename indexType>
+parlay::sequence<indexType> filter_start_points(
+    Labels&& query, parlay::sequence<indexType>& label_starts,
+    indexType default_start, size_t max_starts) {
+  parlay::sequence<indexType> starts;
+  for (indexType l : query)
+    if (l < label_starts.size() && starts.size() < max_starts)
+      starts.push_back(label_starts[l]);
+  if (starts.size() == 0) starts.push_back(default_start);
+  return parlay::remove_duplicates(starts);
+}
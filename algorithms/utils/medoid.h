@@ -0,0 +1,80 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+
+// An approximate medoid of the m points id(0), ..., id(m-1) of Points:
+// the one closest to the centroid of an evenly spaced sample of at most
+// sample_size of them, by Euclidian distance over the coordinates the
+// points expose with operator[].
+template <typename PointRange, typename indexType, typename IdFn>
+indexType approximate_medoid_of(PointRange &Points, size_t m, IdFn id,
+                                size_t sample_size = 10000) {
+  if (m == 0) return 0;
+  unsigned d = Points.dimension();
+  size_t s = std::min(m, sample_size);
+
+  // sums over blocks of the sample, then over the blocks
+  size_t block = 256;
+  size_t num_blocks = (s + block - 1) / block;
+  auto partial = parlay::tabulate(num_blocks, [&](size_t b) {
+    std::vector<double> sum(d, 0.0);
+    for (size_t i = b * block; i < std::min(s, (b + 1) * block); i++) {
+      auto p = Points[id(i * m / s)];
+      for (unsigned j = 0; j < d; j++) sum[j] += (double)p[j];
+    }
+    return sum;
+  });
+  std::vector<float> centroid(d);
+  parlay::parallel_for(0, d, [&](size_t j) {
+    double sum = 0;
+    for (size_t b = 0; b < num_blocks; b++) sum += partial[b][j];
+    centroid[j] = (float)(sum / s);
+  });
+
+  auto dists = parlay::tabulate(m, [&](size_t i) {
+    auto p = Points[id(i)];
+    float dist = 0;
+    for (unsigned j = 0; j < d; j++) {
+      float diff = (float)p[j] - centroid[j];
+      dist += diff * diff;
+    }
+    return dist;
+  });
+  return static_cast<indexType>(id(parlay::min_element(dists) - dists.begin()));
+}
+
+// An approximate medoid of Points, used as the start point of searches.
+// On clustered data it starts searches near the middle of the data rather
+// than at whichever point is first.
+template <typename PointRange, typename indexType>
+indexType approximate_medoid(PointRange &Points, size_t sample_size = 10000) {
+  return approximate_medoid_of<PointRange, indexType>(
+      Points, Points.size(), [](size_t i) { return i; }, sample_size);
+}
@@ -30,6 +30,7 @@
 #include "parlay/internal/file_map.h"
 #include "../bench/parse_command_line.h"
 #include "NSGDist.h"
+#include "distance_kernels.h"
 
 #include "../bench/parse_command_line.h"
 #include "types.h"
@@ -41,55 +42,62 @@
 #include <unistd.h>
 
 
+  template <unsigned D = 0>
   float mips_distance(const uint8_t *p, const uint8_t *q, unsigned d) {
-    int result = 0;
-    for (int i = 0; i < d; i++) {
-      result += ((int32_t)q[i]) * ((int32_t)p[i]);
-    }
-    return -((float)result);
+    return -((float)byte_dot_product<D>(p, q, d));
   }
 
+  template <unsigned D = 0>
   float mips_distance(const int8_t *p, const int8_t *q, unsigned d) {
-    int result = 0;
-    for (int i = 0; i < d; i++) {
-      result += ((int32_t)q[i]) * ((int32_t)p[i]);
-    }
-    return -((float)result);
+    return -((float)byte_dot_product<D>(p, q, d));
   }
 
+  template <unsigned D = 0>
   float mips_distance(const float *p, const float *q, unsigned d) {
-    float result = 0;
-    for (int i = 0; i < d; i++) {
-      result += (q[i]) * (p[i]);
-    }
-    return -result;
+    return -float_dot_product<D>(p, q, d);
   }
 
-template<typename T>
+  template <unsigned D = 0>
+  float mips_distance(const float16 *p, const float16 *q, unsigned d) {
+    return -half_dot_product<D>(p, q, d);
+  }
+
+  template <unsigned D = 0>
+  float mips_distance(const bfloat16 *p, const bfloat16 *q, unsigned d) {
+    return -half_dot_product<D>(p, q, d);
+  }
+
+// With D > 0 the dimension is fixed at compile time and the distances
+// use kernels specialized for it, see distance_kernels.h.
+template<typename T, unsigned D = 0>
 struct Mips_Point {
   using distanceType = float; 
-  template<class C> friend struct Quantized_Mips_Point;
   
   static distanceType d_min() {return -std::numeric_limits<float>::max();}
   static bool is_metric() {return false;}
   T operator [](long i) {return *(values + i);}
 
-  float distance(Mips_Point<T> x) {
-    return mips_distance(this->values, x.values, d);
+  static constexpr unsigned fixed_dims = D;
+
+  float distance(Mips_Point<T, D> x) {
+    return mips_distance<D>(this->values, x.values, d);
   }
 
-  void prefetch() {
-    int l = (aligned_d * sizeof(T))/64;
-    for (int i=0; i < l; i++)
-      __builtin_prefetch((char*) values + i* 64);
+  // distances to the rows base + ids[j] * stride for j < m
+  template<typename indexType>
+  void distance_batch(const T* base, size_t stride, const indexType* ids,
+                      size_t m, float* out) {
+    mips_distance_batch<D>(values, base, stride, ids, m, d, out);
   }
 
+  void prefetch() { prefetch_row(values, aligned_d); }
+
   long id() {return id_;}
 
   Mips_Point(const T* values, unsigned int d, unsigned int ad, long id)
     : values(values), d(d), aligned_d(ad), id_(id) {}
 
-  bool operator==(Mips_Point<T> q){
+  bool operator==(Mips_Point<T, D> q){
     for (int i = 0; i < d; i++) {
       if (values[i] != q.values[i]) {
         return false;
@@ -104,81 +112,3 @@ private:
   unsigned int aligned_d;
   long id_;
 };
-
-template<typename T>
-float quantized_mips_distance(const float* q, const T* p, unsigned d, float max_coord, float min_coord){
-  float result = 0;
-  uint T_bits = sizeof(T)*8;
-  float maxval = static_cast<float>(static_cast<T>((((size_t) 1) << T_bits)-1));
-  float delta = max_coord - min_coord;
-  float mult = delta/maxval;
-  float dc;
-  for(int i=0; i<d; i++){
-    dc = static_cast<float>(p[i])*mult + min_coord;
-    result += dc*q[i];
-  }
-  return result;
-}
-
-template<typename T>
-float quantized_mips_distance(const T* q, const T* p, unsigned d, float max_coord, float min_coord){
-  float result = 0;
-  uint T_bits = sizeof(T)*8;
-  float maxval = static_cast<float>(static_cast<T>((((size_t) 1) << T_bits)-1));
-  float delta = max_coord - min_coord;
-  float mult = delta/maxval;
-  float dc;
-  float dcq;
-  for(int i=0; i<d; i++){
-    dc = static_cast<float>(p[i])*mult + min_coord;
-    dcq = static_cast<float>(q[i])*mult + min_coord;
-    result += dc*dcq;
-  }
-  return result;
-}
-
-
-template<typename T>
-struct Quantized_Mips_Point{
-    using distanceType = float; 
-  
-  static distanceType d_min() {return -std::numeric_limits<float>::max();}
-  static bool is_metric() {return false;}
-  
-  T operator [] (long j) {if(j >= d) abort(); return *(values+j);}
-
-
-  float distance(Mips_Point<float> x) {return quantized_mips_distance(x.values, this->values, d, max_coord, min_coord);}
-
-  float distance(Quantized_Mips_Point<T> x){return quantized_mips_distance(x.values, this->values, d, max_coord, min_coord);}
-
-  void prefetch() {
-    int l = (aligned_d * sizeof(T))/64;
-    for (int i=0; i < l; i++)
-      __builtin_prefetch((char*) values + i* 64);
-  }
-
-  long id() {return id_;}
-
-  Quantized_Mips_Point(const T* values, unsigned int d, unsigned int ad, long id, float max_coord, float min_coord)
-    : values(values), d(d), aligned_d(ad), id_(id), max_coord(max_coord), min_coord(min_coord) {;
-    }
-
-  bool operator==(Quantized_Mips_Point<T> q){
-    for (int i = 0; i < d; i++) {
-      if (values[i] != q.values[i]) {
-        return false;
-      }
-    }
-    return true;
-  }
-
-
-private:
-  const T* values;
-  unsigned int d;
-  unsigned int aligned_d;
-  long id_;
-  float min_coord;
-  float max_coord;
-};
\ No newline at end of file
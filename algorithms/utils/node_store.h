@@ -0,0 +1,167 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "graph.h"
+#include "point_range.h"
+
+// A node store keeps the vector and the adjacency list of each vertex in
+// one block of whole cache lines, so a search touches one region of memory
+// per vertex instead of one in the points and another in the graph.  A
+// block holds the vector padded to the aligned dimension, then the degree
+// and maxDeg neighbor slots of the graph row, padded to a multiple of 64
+// bytes.
+//
+// The store is searched through two views over the same blocks:
+// graph() behaves like a Graph and points() like a PointRange, so that
+// beam_search runs on it unchanged.  Since the blocks are laid out at a
+// fixed stride, the batched distance kernels read vectors straight out of
+// them.  Prefetching a point also fetches the first line of its
+// adjacency list, which holds the degree and the first neighbors, so a
+// vertex scored while expanding a neighbor is ready to be visited.
+
+template <typename indexType>
+struct node_graph {
+  long max_degree() { return maxDeg; }
+  size_t size() { return n; }
+
+  edgeRange<indexType> operator[](indexType i) {
+    indexType* row =
+        (indexType*)(blocks.get() + i * block_bytes + adjacency_offset);
+    return edgeRange<indexType>(row, row + maxDeg + 1, i);
+  }
+
+  std::shared_ptr<char[]> blocks;
+  size_t block_bytes;
+  size_t adjacency_offset;
+  size_t n;
+  long maxDeg;
+};
+
+template <typename T, class Point>
+struct node_points {
+  long dimension() { return dims; }
+  long aligned_dimension() { return aligned_dims; }
+  size_t size() { return n; }
+
+  Point operator[](long i) {
+    return Point((T*)(blocks.get() + i * block_bytes), dims, prefetch_dims, i);
+  }
+
+  template <typename indexType>
+  void distance_batch(Point q, const indexType* ids, size_t m,
+                      typename Point::distanceType* out) {
+    q.distance_batch((T*)blocks.get(), block_bytes / sizeof(T), ids, m, out);
+  }
+
+  // see PointRange::distance_batch_bounded
+  template <typename indexType>
+  void distance_batch_bounded(Point q, const indexType* ids, size_t m,
+                              const typename Point::distanceType* bounds,
+                              typename Point::distanceType* out) {
+    if constexpr (point_bounded<Point>::value)
+      q.distance_batch_bounded((T*)blocks.get(), block_bytes / sizeof(T), ids,
+                               m, bounds, out);
+    else
+      q.distance_batch((T*)blocks.get(), block_bytes / sizeof(T), ids, m, out);
+  }
+
+  std::shared_ptr<char[]> blocks;
+  size_t block_bytes;
+  size_t n;
+  unsigned int dims;
+  unsigned int aligned_dims;
+  // the vector and the first line of the adjacency list
+  unsigned int prefetch_dims;
+};
+
+template <typename T, class Point, typename indexType>
+struct node_store {
+  size_t size() { return n; }
+  size_t block_bytes() { return block; }
+
+  node_store() : blocks(std::shared_ptr<char[]>(nullptr, std::free)) {}
+
+  // copies the points and graph, which must have the same size, into
+  // fused blocks
+  template <typename PointRange>
+  node_store(PointRange& Points, Graph<indexType>& G)
+      : blocks(std::shared_ptr<char[]>(nullptr, std::free)) {
+    if (Points.size() != G.size()) {
+      std::cout << "ERROR: node store needs a graph with " << Points.size()
+                << " points, got " << G.size() << std::endl;
+      abort();
+    }
+    n = G.size();
+    maxDeg = G.max_degree();
+    dims = Points.dimension();
+    aligned_dims = Points.aligned_dimension();
+    adjacency_offset = aligned_dims * sizeof(T);
+    size_t bytes = adjacency_offset + (maxDeg + 1) * sizeof(indexType);
+    block = 64 * ((bytes + 63) / 64);
+    blocks = std::shared_ptr<char[]>((char*)aligned_alloc(64, n * block),
+                                     std::free);
+    parlay::parallel_for(0, n, [&](size_t i) {
+      char* b = blocks.get() + i * block;
+      std::memset(b, 0, block);
+      T* v = (T*)b;
+      Point p = Points[i];
+      for (unsigned int j = 0; j < dims; j++) v[j] = p[j];
+      indexType* row = (indexType*)(b + adjacency_offset);
+      auto nbhs = G[i];
+      row[0] = nbhs.size();
+      for (indexType j = 0; j < nbhs.size(); j++) row[j + 1] = nbhs[j];
+    });
+    std::cout << "Built node store of " << n << " blocks of " << block
+              << " bytes" << std::endl;
+  }
+
+  node_graph<indexType> graph() {
+    return node_graph<indexType>{blocks, block, adjacency_offset, n, maxDeg};
+  }
+
+  node_points<T, Point> points() {
+    unsigned int line = 64 / sizeof(T);
+    unsigned int prefetch_dims =
+        std::min<size_t>(aligned_dims + line, block / sizeof(T));
+    return node_points<T, Point>{blocks,       block, n, dims,
+                                 aligned_dims, prefetch_dims};
+  }
+
+ private:
+  std::shared_ptr<char[]> blocks;
+  size_t block;
+  size_t adjacency_offset;
+  size_t n;
+  long maxDeg;
+  unsigned int dims;
+  unsigned int aligned_dims;
+};
@@ -0,0 +1,182 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "parlay/internal/get_time.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+
+// Bulk file I/O shared by the loaders and savers of points, graphs and
+// ground truth.  Each read or write of a byte range is split into
+// IO_CHUNK_BYTES chunks that parlay workers transfer concurrently with
+// pread and pwrite, which keeps a fast storage array busy where a single
+// stream cannot.  report() prints the throughput of the transfers so far.
+//
+// With PARLAYANN_O_DIRECT=1 files are read with O_DIRECT, bypassing the
+// page cache: each chunk is read into a block aligned bounce buffer and
+// copied out.  Writes always go through the page cache, since O_DIRECT
+// would require merging the partial blocks at both ends of every write.
+constexpr size_t IO_CHUNK_BYTES = 1 << 23;
+constexpr size_t IO_DIRECT_ALIGN = 4096;
+
+struct parallel_file {
+  // exits if the file cannot be opened, unless required is false, in which
+  // case is_open() reports it
+  parallel_file(const char* filename, bool write, bool required = true)
+      : name(filename), writing(write) {
+    if (write) {
+      fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    } else {
+      const char* d = std::getenv("PARLAYANN_O_DIRECT");
+      if (d != nullptr && std::string(d) == "1") {
+        fd = open(filename, O_RDONLY | O_DIRECT);
+        direct = (fd != -1);
+      }
+      if (fd == -1) fd = open(filename, O_RDONLY);
+    }
+    if (fd == -1 && required) {
+      perror(filename);
+      exit(-1);
+    }
+  }
+
+  parallel_file(const parallel_file&) = delete;
+  parallel_file& operator=(const parallel_file&) = delete;
+
+  ~parallel_file() {
+    if (fd != -1) close(fd);
+  }
+
+  bool is_open() { return fd != -1; }
+
+  size_t size() {
+    struct stat sb;
+    if (fstat(fd, &sb) == -1) {
+      perror("fstat");
+      exit(-1);
+    }
+    return sb.st_size;
+  }
+
+  // reads bytes bytes at offset into buf
+  void read(void* buf, size_t bytes, size_t offset) {
+    parlay::internal::timer t("read", true);
+    size_t chunks = (bytes + IO_CHUNK_BYTES - 1) / IO_CHUNK_BYTES;
+    parlay::parallel_for(0, chunks, [&](size_t c) {
+      size_t start = c * IO_CHUNK_BYTES;
+      size_t len = std::min(IO_CHUNK_BYTES, bytes - start);
+      if (direct)
+        read_direct((char*)buf + start, len, offset + start);
+      else
+        read_range((char*)buf + start, len, offset + start);
+    }, 1);
+    seconds += t.next_time();
+    moved += bytes;
+  }
+
+  // writes bytes bytes from buf at offset
+  void write(const void* buf, size_t bytes, size_t offset) {
+    parlay::internal::timer t("write", true);
+    size_t chunks = (bytes + IO_CHUNK_BYTES - 1) / IO_CHUNK_BYTES;
+    parlay::parallel_for(0, chunks, [&](size_t c) {
+      size_t start = c * IO_CHUNK_BYTES;
+      size_t len = std::min(IO_CHUNK_BYTES, bytes - start);
+      write_range((const char*)buf + start, len, offset + start);
+    }, 1);
+    seconds += t.next_time();
+    moved += bytes;
+  }
+
+  void report() {
+    std::cout << (writing ? "Wrote " : "Read ") << moved / 1e9 << " GB "
+              << (writing ? "to " : "from ") << name << " at "
+              << (seconds > 0 ? moved / 1e9 / seconds : 0) << " GB/s"
+              << std::endl;
+  }
+
+ private:
+  int fd = -1;
+  std::string name;
+  bool writing;
+  bool direct = false;
+  size_t moved = 0;
+  double seconds = 0;
+
+  // reads until len bytes are read or the file ends, returns the count
+  size_t read_upto(char* buf, size_t len, size_t offset) {
+    size_t done = 0;
+    while (done < len) {
+      ssize_t r = pread(fd, buf + done, len - done, offset + done);
+      if (r == -1) {
+        perror("pread");
+        exit(-1);
+      }
+      if (r == 0) break;
+      done += r;
+    }
+    return done;
+  }
+
+  void read_range(char* buf, size_t len, size_t offset) {
+    if (read_upto(buf, len, offset) != len) {
+      std::cout << "ERROR: unexpected end of file in " << name << std::endl;
+      abort();
+    }
+  }
+
+  void read_direct(char* buf, size_t len, size_t offset) {
+    size_t start = offset - offset % IO_DIRECT_ALIGN;
+    size_t end = (offset + len + IO_DIRECT_ALIGN - 1) / IO_DIRECT_ALIGN *
+                 IO_DIRECT_ALIGN;
+    char* bounce = (char*)aligned_alloc(IO_DIRECT_ALIGN, end - start);
+    if (read_upto(bounce, end - start, start) < offset + len - start) {
+      std::cout << "ERROR: unexpected end of file in " << name << std::endl;
+      abort();
+    }
+    std::memcpy(buf, bounce + (offset - start), len);
+    std::free(bounce);
+  }
+
+  void write_range(const char* buf, size_t len, size_t offset) {
+    size_t done = 0;
+    while (done < len) {
+      ssize_t r = pwrite(fd, buf + done, len - done, offset + done);
+      if (r == -1) {
+        perror("pwrite");
+        exit(-1);
+      }
+      done += r;
+    }
+  }
+};
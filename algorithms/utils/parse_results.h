@@ -25,6 +25,7 @@
 
 #include <algorithm>
 #include <set>
+#include <string>
 
 #include "parlay/parallel.h"
 #include "parlay/primitives.h"
@@ -83,7 +84,9 @@ struct range_result {
   int k;
   int beamQ;
   float cut;
+  // the beam grows to at most slack * beamQ, see range_search
   double slack;
+  double radius = 0;
 
   range_result(int nq, int nnq, double r, double r2,
                parlay::sequence<size_t> stats, float qps, int K, int Q, float c,
@@ -106,6 +109,15 @@ struct range_result {
   }
 
   void print() {
+    std::cout << "For radius " << radius << " recall = " << recall
+              << ", alternate recall = " << alt_recall << ", QPS = " << QPS
+              << ", Q = " << beamQ << ", slack = " << slack
+              << ", average visited = " << avg_visited
+              << ", tail visited = " << tail_visited
+              << ", average cmps = " << avg_cmps << std::endl;
+  }
+
+  void print_verbose() {
     std::cout << "k = " << k << ", Q = " << beamQ << ", cut = " << cut
               << ", slack = " << slack << ", throughput = " << QPS << "/second"
               << std::endl;
@@ -138,6 +150,18 @@ struct nn_result {
   int limit;
   int degree_limit;
   int gtn;
+  // beam entries re-ranked with exact distances, 0 without quantization
+  long rerank_k = 0;
+  // for filtered searches, the points the beam traverses: "all" or
+  // "matching" (see filtered_beam_search)
+  std::string filter;
+  // adaptive termination, see QueryParams
+  long patience = 0;
+  double stop_ratio = 0;
+  // per-query budgets, see QueryParams, and the queries that ran out of them
+  long max_dist_cmps = 0;
+  long deadline_us = 0;
+  long truncated = 0;
 
   long num_queries;
 
@@ -164,6 +188,14 @@ struct nn_result {
     std::cout << "For " << gtn << "@" << gtn << " recall = " << recall
               << ", QPS = " << QPS << ", Q = " << beamQ << ", cut = " << cut;
     std::cout << ", visited limit = " << limit << ", degree limit: " << degree_limit;
+    if (rerank_k > 0) std::cout << ", rerank = " << rerank_k;
+    if (!filter.empty()) std::cout << ", traverse = " << filter;
+    if (patience > 0) std::cout << ", patience = " << patience;
+    if (stop_ratio > 0) std::cout << ", stop ratio = " << stop_ratio;
+    if (max_dist_cmps > 0) std::cout << ", cmps budget = " << max_dist_cmps;
+    if (deadline_us > 0) std::cout << ", deadline = " << deadline_us << "us";
+    if (max_dist_cmps > 0 || deadline_us > 0)
+      std::cout << ", truncated = " << truncated;
     std::cout << ", average visited = " << avg_visited << ", average cmps = " << avg_cmps << std::endl;
   }
 
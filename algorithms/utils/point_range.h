@@ -23,7 +23,14 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 #include "../bench/parse_command_line.h"
 #include "parlay/internal/file_map.h"
@@ -33,6 +40,7 @@
 
 #include "../bench/parse_command_line.h"
 #include "types.h"
+#include "parallel_io.h"
 // #include "common/time_loop.h"
 
 #include <fcntl.h>
@@ -51,54 +59,172 @@ long dim_round_up(long dim, long tp_size) {
 	return ((qt + 1) * 64) / tp_size;
 }
 
+// Header of the aligned copy written next to a base file whose rows are
+// not a multiple of 64 bytes; the padded rows follow at offset
+// ALIGNED_POINTS_HEADER_BYTES.  The size and modification time of the base
+// file are recorded so that a stale copy is rewritten.
+constexpr uint64_t ALIGNED_POINTS_MAGIC = 0x0053544e504e4e41;  // "ANNPNTS"
+constexpr size_t ALIGNED_POINTS_HEADER_BYTES = 4096;
+
+struct aligned_points_header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t elem_bytes;
+  uint64_t n;
+  uint64_t dims;
+  uint64_t aligned_dims;
+  uint64_t source_bytes;
+  int64_t source_mtime;
+};
+
+// Point types over quantized rows name the quantizer that encodes them as
+// Point::Quantizer, see quantized_point.h; it is void for other points.
+template<class Point, class = void>
+struct point_quantizer {
+  using type = void;
+};
+
+template<class Point>
+struct point_quantizer<Point, std::void_t<typename Point::Quantizer>> {
+  using type = typename Point::Quantizer;
+};
+
+// Point types whose vectors are scaled to unit length as they are read
+// provide a static normalize(T* row, unsigned int d), see cosine_point.h.
+template<class Point, class = void>
+struct point_normalizes : std::false_type {};
+
+template<class Point>
+struct point_normalizes<Point, std::void_t<decltype(&Point::normalize)>>
+	: std::true_type {};
+
+// The dimension of Point types that fix it at compile time, as
+// Point::fixed_dims, see euclidian_point.h; 0 for other points.
+template<class Point, class = void>
+struct point_fixed_dims : std::integral_constant<unsigned, 0> {};
+
+template<class Point>
+struct point_fixed_dims<Point, std::void_t<decltype(Point::fixed_dims)>>
+	: std::integral_constant<unsigned, Point::fixed_dims> {};
+
+// Point types whose distances can stop early once they are known to exceed
+// a bound provide distance_batch_bounded, see euclidian_point.h; the
+// distances to other points are computed in full.
+template<class Point, class = void>
+struct point_bounded : std::false_type {};
+
+template<class Point>
+struct point_bounded<Point, std::void_t<decltype(
+	&Point::template distance_batch_bounded<unsigned int>)>>
+	: std::true_type {};
+
 template<typename T, class Point>
 struct PointRange {
+  using Quantizer = typename point_quantizer<Point>::type;
+  static constexpr bool quantized = !std::is_void<Quantizer>::value;
+  static constexpr bool normalized = point_normalizes<Point>::value;
+  static constexpr unsigned fixed_dims = point_fixed_dims<Point>::value;
+
   long dimension() { return dims; }
 
   long aligned_dimension() { return aligned_dims; }
 
   PointRange() : values(std::shared_ptr<T[]>(nullptr, std::free)) { n = 0; }
 
-  PointRange(char *filename)
+  // With mapped the points are mapped from disk instead of copied into
+  // memory, see map_points.  Quantized points are read from a float file
+  // and encoded as they are read, see quantize_points.  Normalized points
+  // are scaled in memory after they are read, so they are never mapped.
+  PointRange(char *filename, bool mapped = false)
 	  : values(std::shared_ptr<T[]>(nullptr, std::free)) {
 	if (filename == NULL) {
 	  n = 0;
 	  dims = 0;
 	  return;
 	}
-	std::ifstream reader(filename);
-	assert(reader.is_open());
+	if constexpr (quantized) {
+	  quantize_points(filename);
+	  return;
+	}
+	if (mapped && normalized)
+	  std::cout << "Normalized points are read, not mapped" << std::endl;
+	else if (mapped && map_points(filename))
+	  return;
+	parallel_file reader(filename, false);
 
-	// read num points and max degree
-	unsigned int num_points;
-	unsigned int d;
-	reader.read((char *)(&num_points), sizeof(unsigned int));
-	n = num_points;
-	reader.read((char *)(&d), sizeof(unsigned int));
-	dims = d;
-	std::cout << "Detected " << num_points << " points with dimension " << d
+	// read num points and dimension
+	unsigned int header[2];
+	reader.read(header, 2 * sizeof(unsigned int), 0);
+	n = header[0];
+	dims = header[1];
+	std::cout << "Detected " << n << " points with dimension " << dims
 			  << std::endl;
+	check_fixed_dims();
 	aligned_dims = dim_round_up(dims, sizeof(T));
 	if (aligned_dims != dims)
 	  std::cout << "Aligning dimension to " << aligned_dims << std::endl;
 	values = std::shared_ptr<T[]>(
 		(T *)aligned_alloc(64, n * aligned_dims * sizeof(T)), std::free);
-	size_t BLOCK_SIZE = 1000000;
-	size_t index = 0;
-	while (index < n) {
-	  size_t floor = index;
-	  size_t ceiling = index + BLOCK_SIZE <= n ? index + BLOCK_SIZE : n;
-	  T *data_start = new T[(ceiling - floor) * dims];
-	  reader.read((char *)(data_start), sizeof(T) * (ceiling - floor) * dims);
-	  T *data_end = data_start + (ceiling - floor) * dims;
-	  parlay::slice<T *, T *> data = parlay::make_slice(data_start, data_end);
-	  int data_bytes = dims * sizeof(T);
-	  parlay::parallel_for(floor, ceiling, [&](size_t i) {
-		std::memmove(values.get() + i * aligned_dims,
-					 data.begin() + (i - floor) * dims, data_bytes);
+	size_t offset = 2 * sizeof(unsigned int);
+	if (aligned_dims == dims) {
+	  reader.read(values.get(), n * dims * sizeof(T), offset);
+	} else {
+	  size_t BLOCK_SIZE = 1000000;
+	  size_t index = 0;
+	  parlay::sequence<T> data(std::min(n, BLOCK_SIZE) * dims);
+	  while (index < n) {
+		size_t floor = index;
+		size_t ceiling = index + BLOCK_SIZE <= n ? index + BLOCK_SIZE : n;
+		reader.read(data.begin(), (ceiling - floor) * dims * sizeof(T),
+					offset + floor * dims * sizeof(T));
+		int data_bytes = dims * sizeof(T);
+		parlay::parallel_for(floor, ceiling, [&](size_t i) {
+		  std::memmove(values.get() + i * aligned_dims,
+					   data.begin() + (i - floor) * dims, data_bytes);
+		});
+		index = ceiling;
+	  }
+	}
+	if constexpr (normalized) {
+	  parlay::parallel_for(0, n, [&](size_t i) {
+		Point::normalize(values.get() + i * aligned_dims, dims);
+	  });
+	}
+	reader.report();
+  }
+
+  // Points read from filename to be compared with the points of Base.
+  // Quantized points keep these in float, transformed for the quantizer
+  // of Base, so that their distances to Base are asymmetric.
+  PointRange(char *filename, PointRange &Base)
+	  : PointRange(quantized ? nullptr : filename) {
+	if constexpr (quantized) {
+	  if (filename == NULL) return;
+	  parallel_file reader(filename, false);
+	  unsigned int header[2];
+	  reader.read(header, 2 * sizeof(unsigned int), 0);
+	  n = header[0];
+	  dims = header[1];
+	  std::cout << "Detected " << n << " queries with dimension " << dims
+				<< std::endl;
+	  if (dims != Base.dims) {
+		std::cout << "ERROR: queries have dimension " << dims
+				  << ", points have dimension " << Base.dims << std::endl;
+		abort();
+	  }
+	  quantizer = Base.quantizer;
+	  aligned_dims = Base.aligned_dims;
+	  size_t stride = quantizer->query_floats();
+	  parlay::sequence<float> data(n * dims);
+	  reader.read(data.begin(), n * dims * sizeof(float),
+				  2 * sizeof(unsigned int));
+	  queries = std::shared_ptr<float[]>(
+		  (float *)aligned_alloc(64, n * stride * sizeof(float)), std::free);
+	  parlay::parallel_for(0, n, [&](size_t i) {
+		Point::transform_query(*quantizer, data.begin() + i * dims,
+							   queries.get() + i * stride);
 	  });
-	  delete[] data_start;
-	  index = ceiling;
+	  reader.report();
 	}
   }
 
@@ -108,6 +234,7 @@ struct PointRange {
 	pr.n = n - offset;
 	pr.dims = dims;
 	pr.aligned_dims = aligned_dims;
+	pr.quantizer = quantizer;
 	pr.values = std::shared_ptr<T[]>(
 		(T *)aligned_alloc(64, pr.n * aligned_dims * sizeof(T)), std::free); // allocates memory for the new point range
 	std::memmove(pr.values.get(), values.get() + offset * aligned_dims,
@@ -115,6 +242,58 @@ struct PointRange {
 	return pr;
   }
 
+  // the points with point order[i] moved to i, see reorder.h
+  PointRange permute(const parlay::sequence<unsigned int> &order) {
+	auto pr = PointRange();
+	pr.n = n;
+	pr.dims = dims;
+	pr.aligned_dims = aligned_dims;
+	pr.quantizer = quantizer;
+	pr.values = std::shared_ptr<T[]>(
+		(T *)aligned_alloc(64, n * aligned_dims * sizeof(T)), std::free);
+	parlay::parallel_for(0, n, [&](size_t i) {
+	  std::memmove(pr.values.get() + i * aligned_dims,
+				   values.get() + (size_t)order[i] * aligned_dims,
+				   aligned_dims * sizeof(T));
+	});
+	return pr;
+  }
+
+  // writes the points in the format read by PointRange(char*)
+  void save(char *oFile) {
+	if constexpr (quantized) {
+	  std::cout << "ERROR: quantized points are not saved, quantize the "
+				   "float file when it is read"
+				<< std::endl;
+	  abort();
+	}
+	std::cout << "Writing " << n << " points with dimension " << dims
+			  << std::endl;
+	unsigned int preamble[2] = {static_cast<unsigned int>(n), dims};
+	parallel_file writer(oFile, true);
+	writer.write(preamble, 2 * sizeof(unsigned int), 0);
+	size_t offset = 2 * sizeof(unsigned int);
+	if (aligned_dims == dims) {
+	  writer.write(values.get(), n * dims * sizeof(T), offset);
+	} else {
+	  size_t BLOCK_SIZE = 1000000;
+	  size_t index = 0;
+	  while (index < n) {
+		size_t floor = index;
+		size_t ceiling = index + BLOCK_SIZE <= n ? index + BLOCK_SIZE : n;
+		parlay::sequence<T> data((ceiling - floor) * dims);
+		parlay::parallel_for(floor, ceiling, [&](size_t i) {
+		  std::memmove(data.begin() + (i - floor) * dims,
+					   values.get() + i * aligned_dims, dims * sizeof(T));
+		});
+		writer.write(data.begin(), data.size() * sizeof(T),
+					 offset + floor * dims * sizeof(T));
+		index = ceiling;
+	  }
+	}
+	writer.report();
+  }
+
   void print() {
 	for (long i = 0; i < n; i++) {
 	  for (long j = 0; j < dims; j++) {
@@ -127,7 +306,35 @@ struct PointRange {
   size_t size() { return n; }
 
   Point operator[](long i) {
-	return Point(values.get() + i * aligned_dims, dims, aligned_dims, i);
+	if constexpr (quantized) {
+	  if (queries != nullptr)
+		return Point(nullptr, dims, aligned_dims, i, quantizer.get(),
+					 queries.get() + i * quantizer->query_floats());
+	  return Point(values.get() + i * aligned_dims, dims, aligned_dims, i,
+				   quantizer.get());
+	} else {
+	  return Point(values.get() + i * aligned_dims, dims, aligned_dims, i);
+	}
+  }
+
+  // distances from q to the points ids[0..m), written to out
+  template<typename indexType>
+  void distance_batch(Point q, const indexType *ids, size_t m,
+					  typename Point::distanceType *out) {
+	q.distance_batch(values.get(), aligned_dims, ids, m, out);
+  }
+
+  // the same, except that the distance to ids[j] may stop early, at some
+  // value above bounds[j], once it is known to exceed bounds[j]; out may
+  // be bounds
+  template<typename indexType>
+  void distance_batch_bounded(Point q, const indexType *ids, size_t m,
+							  const typename Point::distanceType *bounds,
+							  typename Point::distanceType *out) {
+	if constexpr (point_bounded<Point>::value)
+	  q.distance_batch_bounded(values.get(), aligned_dims, ids, m, bounds, out);
+	else
+	  q.distance_batch(values.get(), aligned_dims, ids, m, out);
   }
 
  private:
@@ -135,4 +342,172 @@ struct PointRange {
   unsigned int dims;
   unsigned int aligned_dims;
   size_t n;
+  // for quantized points, where aligned_dims is the bytes in a row of
+  // codes; queries holds the transformed queries of a range of queries
+  std::shared_ptr<Quantizer> quantizer;
+  std::shared_ptr<float[]> queries;
+
+  // the kernels of a Point with a fixed dimension ignore the one passed
+  void check_fixed_dims() {
+	if (fixed_dims != 0 && dims != fixed_dims) {
+	  std::cout << "ERROR: points have dimension " << dims
+				<< ", this build expects " << fixed_dims << std::endl;
+	  abort();
+	}
+  }
+
+  // Reads float points in blocks, twice: the first pass finds the range of
+  // each dimension, which fits the quantizer, and the second encodes the
+  // points, so the float file is never held in memory whole.
+  void quantize_points(char *filename) {
+	parallel_file reader(filename, false);
+	unsigned int header[2];
+	reader.read(header, 2 * sizeof(unsigned int), 0);
+	n = header[0];
+	dims = header[1];
+	std::cout << "Detected " << n << " points with dimension " << dims
+			  << std::endl;
+	size_t offset = 2 * sizeof(unsigned int);
+	size_t BLOCK_SIZE = 1000000;
+	parlay::sequence<float> data(std::min(n, BLOCK_SIZE) * dims);
+	std::vector<float> lo(dims, std::numeric_limits<float>::max());
+	std::vector<float> hi(dims, std::numeric_limits<float>::lowest());
+	for (size_t floor = 0; floor < n; floor += BLOCK_SIZE) {
+	  size_t ceiling = std::min(floor + BLOCK_SIZE, n);
+	  reader.read(data.begin(), (ceiling - floor) * dims * sizeof(float),
+				  offset + floor * dims * sizeof(float));
+	  parlay::parallel_for(0, dims, [&](size_t j) {
+		for (size_t i = 0; i < ceiling - floor; i++) {
+		  lo[j] = std::min(lo[j], data[i * dims + j]);
+		  hi[j] = std::max(hi[j], data[i * dims + j]);
+		}
+	  });
+	}
+	quantizer = std::make_shared<Quantizer>(lo, hi);
+	aligned_dims = quantizer->row_bytes();
+	values = std::shared_ptr<T[]>((T *)aligned_alloc(64, n * aligned_dims),
+								  std::free);
+	for (size_t floor = 0; floor < n; floor += BLOCK_SIZE) {
+	  size_t ceiling = std::min(floor + BLOCK_SIZE, n);
+	  reader.read(data.begin(), (ceiling - floor) * dims * sizeof(float),
+				  offset + floor * dims * sizeof(float));
+	  parlay::parallel_for(floor, ceiling, [&](size_t i) {
+		quantizer->encode(data.begin() + (i - floor) * dims,
+						  (uint8_t *)values.get() + i * aligned_dims);
+	  });
+	}
+	std::cout << "Quantized to " << aligned_dims << " bytes per point"
+			  << std::endl;
+	reader.report();
+  }
+
+  // Maps the points so that startup does not read the file and processes
+  // serving the same corpus share its pages.  If rows are already a
+  // multiple of 64 bytes the base file itself is mapped; its rows then
+  // start 8 bytes past a cache line, which the distance kernels allow
+  // since they use unaligned loads, but each row spans one more line than
+  // it would aligned: one more line to fetch and prefetch (see
+  // prefetch_row) per distance.  Otherwise a padded copy is written
+  // once to filename.aligned, and this and later runs map the copy.
+  // Returns false if the copy cannot be written.
+  bool map_points(char *filename) {
+	struct stat sb;
+	if (stat(filename, &sb) == -1) {
+	  perror("stat");
+	  exit(-1);
+	}
+	unsigned int header[2];
+	std::ifstream reader(filename);
+	assert(reader.is_open());
+	reader.read((char *)header, 2 * sizeof(unsigned int));
+	n = header[0];
+	dims = header[1];
+	check_fixed_dims();
+	aligned_dims = dim_round_up(dims, sizeof(T));
+	if (aligned_dims == dims) {
+	  values = map_rows(filename, 2 * sizeof(unsigned int),
+						n * dims * sizeof(T));
+	  std::cout << "Mapped " << n << " points with dimension " << dims
+				<< std::endl;
+	  return true;
+	}
+
+	std::string copy = std::string(filename) + ".aligned";
+	aligned_points_header expected = {
+		ALIGNED_POINTS_MAGIC, 1, sizeof(T), n, dims, aligned_dims,
+		static_cast<uint64_t>(sb.st_size), static_cast<int64_t>(sb.st_mtime)};
+	if (!valid_aligned_copy(copy, expected) &&
+		!write_aligned_copy(filename, copy, expected)) {
+	  std::cout << "Could not write " << copy << ", reading points instead"
+				<< std::endl;
+	  return false;
+	}
+	values = map_rows(copy.c_str(), ALIGNED_POINTS_HEADER_BYTES,
+					  n * aligned_dims * sizeof(T));
+	std::cout << "Mapped " << n << " points with dimension " << dims
+			  << " aligned to " << aligned_dims << " from " << copy
+			  << std::endl;
+	return true;
+  }
+
+  static std::shared_ptr<T[]> map_rows(const char *file, size_t offset,
+									   size_t bytes) {
+	std::pair<char *, size_t> m = mmapStringFromFile(file);
+	if (m.second < offset + bytes) {
+	  std::cout << "ERROR: " << file << " has " << m.second
+				<< " bytes, expected " << offset + bytes << std::endl;
+	  abort();
+	}
+	return std::shared_ptr<T[]>((T *)(m.first + offset),
+								[m](T *) { munmap(m.first, m.second); });
+  }
+
+  static bool valid_aligned_copy(std::string copy,
+								 aligned_points_header expected) {
+	aligned_points_header header;
+	std::ifstream reader(copy);
+	if (!reader.is_open()) return false;
+	reader.read((char *)(&header), sizeof(header));
+	return reader && std::memcmp(&header, &expected, sizeof(header)) == 0;
+  }
+
+  // the copy is written under a temporary name and renamed into place, so
+  // a concurrent run never maps a partial copy
+  bool write_aligned_copy(char *filename, std::string copy,
+						  aligned_points_header header) {
+	std::cout << "Writing aligned copy of " << filename << " to " << copy
+			  << std::endl;
+	std::string tmp = copy + ".tmp" + std::to_string(getpid());
+	{
+	  parallel_file writer(tmp.c_str(), true, false);
+	  if (!writer.is_open()) return false;
+	  std::vector<char> preamble(ALIGNED_POINTS_HEADER_BYTES, 0);
+	  std::memcpy(preamble.data(), &header, sizeof(header));
+	  writer.write(preamble.data(), preamble.size(), 0);
+
+	  std::shared_ptr<T[]> source =
+		  map_rows(filename, 2 * sizeof(unsigned int), n * dims * sizeof(T));
+	  size_t BLOCK_SIZE = 1000000;
+	  size_t index = 0;
+	  while (index < n) {
+		size_t floor = index;
+		size_t ceiling = index + BLOCK_SIZE <= n ? index + BLOCK_SIZE : n;
+		parlay::sequence<T> data((ceiling - floor) * aligned_dims, 0);
+		parlay::parallel_for(floor, ceiling, [&](size_t i) {
+		  std::memmove(data.begin() + (i - floor) * aligned_dims,
+					   source.get() + i * dims, dims * sizeof(T));
+		});
+		writer.write(data.begin(), data.size() * sizeof(T),
+					 ALIGNED_POINTS_HEADER_BYTES +
+						 floor * aligned_dims * sizeof(T));
+		index = ceiling;
+	  }
+	  writer.report();
+	}
+	if (rename(tmp.c_str(), copy.c_str()) != 0) {
+	  unlink(tmp.c_str());
+	  return false;
+	}
+	return true;
+  }
 };
@@ -0,0 +1,307 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "parallel_io.h"
+
+// Product quantization.  The dimensions are split into M contiguous
+// subspaces, each with a codebook of up to PQ_CENTROIDS centroids trained
+// by k-means, and every point is stored as the M bytes naming its nearest
+// centroid in each subspace.  A query is not encoded: PQPointRange::query
+// fills a table with the distance from the query to every centroid of
+// every subspace, and the distance to a point is the sum of M table
+// entries (asymmetric distance computation).  The table holds squared
+// Euclidian distances, or negated inner products when FullPoint is not a
+// metric (Mips_Point), so distances have the sign of FullPoint's.
+//
+// PQ distances are approximations, so a search on PQ points should
+// re-rank its results with exact distances, see searchAllReranked in
+// beamSearch.h.
+
+constexpr unsigned PQ_CENTROIDS = 256;
+constexpr uint64_t PQ_MAGIC = 0x0000535150504e41;  // "ANNPPQS"
+
+struct pq_header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t dims;
+  uint64_t n;
+  uint32_t M;
+  uint32_t K;
+};
+
+template <class FullPoint>
+struct PQ_Point {
+  using distanceType = float;
+
+  static distanceType d_min() { return FullPoint::d_min(); }
+  static bool is_metric() { return FullPoint::is_metric(); }
+  uint8_t operator[](long j) { return codes[j]; }
+
+  // one of the two points is a query, which has a table and no codes;
+  // there is no distance between two base points
+  float distance(PQ_Point<FullPoint> x) {
+    if (x.table != nullptr) return adc(x.table, codes, M);
+    if (table == nullptr) {
+      std::cout << "ERROR: PQ points only have distances to a query"
+                << std::endl;
+      abort();
+    }
+    return adc(table, x.codes, M);
+  }
+
+  // distances from this query to the codes base + ids[j] * stride
+  template <typename indexType>
+  void distance_batch(const uint8_t* base, size_t stride,
+                      const indexType* ids, size_t m, float* out) {
+    for (size_t j = 0; j < m; j++)
+      out[j] = adc(table, base + (size_t)ids[j] * stride, M);
+  }
+
+  void prefetch() {
+    if (codes == nullptr) return;
+    for (unsigned i = 0; i < M; i += 64)
+      __builtin_prefetch((const char*)codes + i);
+  }
+
+  long id() { return id_; }
+
+  PQ_Point(const uint8_t* codes, const float* table, unsigned M, long id)
+      : codes(codes), table(table), M(M), id_(id) {}
+
+  static float adc(const float* table, const uint8_t* codes, unsigned M) {
+    float d0 = 0, d1 = 0, d2 = 0, d3 = 0;
+    unsigned m = 0;
+    for (; m + 4 <= M; m += 4) {
+      d0 += table[m * PQ_CENTROIDS + codes[m]];
+      d1 += table[(m + 1) * PQ_CENTROIDS + codes[m + 1]];
+      d2 += table[(m + 2) * PQ_CENTROIDS + codes[m + 2]];
+      d3 += table[(m + 3) * PQ_CENTROIDS + codes[m + 3]];
+    }
+    for (; m < M; m++) d0 += table[m * PQ_CENTROIDS + codes[m]];
+    return (d0 + d1) + (d2 + d3);
+  }
+
+ private:
+  const uint8_t* codes;
+  const float* table;
+  unsigned M;
+  long id_;
+};
+
+template <class FullPoint>
+struct PQPointRange {
+  using Point = PQ_Point<FullPoint>;
+
+  size_t size() { return n; }
+  long dimension() { return dims; }
+  unsigned subspaces() { return M; }
+
+  PQPointRange() : n(0), dims(0), M(0), K(0) {}
+
+  // Trains codebooks with M subspaces on train_size points spread evenly
+  // over Points, and encodes all of Points.
+  template <typename PointRange>
+  PQPointRange(PointRange& Points, unsigned M, size_t train_size = 100000,
+               int iters = 10)
+      : n(Points.size()), dims(Points.dimension()), M(M) {
+    if (M == 0 || M > dims) {
+      std::cout << "ERROR: cannot split dimension " << dims << " into " << M
+                << " subspaces" << std::endl;
+      abort();
+    }
+    size_t t = std::min(train_size, n);
+    K = std::min<size_t>(PQ_CENTROIDS, t);
+    parlay::sequence<float> train(t * dims);
+    parlay::parallel_for(0, t, [&](size_t i) {
+      auto p = Points[(i * n) / t];
+      for (unsigned j = 0; j < dims; j++) train[i * dims + j] = p[j];
+    });
+    centroids = std::shared_ptr<float[]>(new float[(size_t)K * dims]);
+    parlay::parallel_for(0, M, [&](size_t m) { train_subspace(train, t, m, iters); }, 1);
+
+    codes = std::shared_ptr<uint8_t[]>(new uint8_t[n * M]);
+    parlay::parallel_for(0, n, [&](size_t i) {
+      std::vector<float> v(dims);
+      auto p = Points[i];
+      for (unsigned j = 0; j < dims; j++) v[j] = p[j];
+      for (unsigned m = 0; m < M; m++)
+        codes[i * M + m] = nearest_centroid(v.data() + start(m), m);
+    });
+    std::cout << "Trained product quantizer with " << M << " subspaces of "
+              << K << " centroids on " << t << " points" << std::endl;
+  }
+
+  // reads codebooks and codes written by save
+  PQPointRange(char* pqFile) {
+    pq_header header;
+    parallel_file reader(pqFile, false);
+    reader.read(&header, sizeof(header), 0);
+    if (header.magic != PQ_MAGIC) {
+      std::cout << "ERROR: " << pqFile << " is not a product quantizer file"
+                << std::endl;
+      abort();
+    }
+    n = header.n;
+    dims = header.dims;
+    M = header.M;
+    K = header.K;
+    centroids = std::shared_ptr<float[]>(new float[(size_t)K * dims]);
+    codes = std::shared_ptr<uint8_t[]>(new uint8_t[n * M]);
+    size_t offset = sizeof(header);
+    reader.read(centroids.get(), (size_t)K * dims * sizeof(float), offset);
+    offset += (size_t)K * dims * sizeof(float);
+    reader.read(codes.get(), n * M, offset);
+    std::cout << "Detected " << n << " product quantized points with " << M
+              << " subspaces" << std::endl;
+    reader.report();
+  }
+
+  void save(char* oFile) {
+    std::cout << "Writing product quantizer for " << n << " points with "
+              << M << " subspaces" << std::endl;
+    pq_header header = {PQ_MAGIC, 1, dims, n, M, K};
+    parallel_file writer(oFile, true);
+    writer.write(&header, sizeof(header), 0);
+    size_t offset = sizeof(header);
+    writer.write(centroids.get(), (size_t)K * dims * sizeof(float), offset);
+    offset += (size_t)K * dims * sizeof(float);
+    writer.write(codes.get(), n * M, offset);
+    writer.report();
+  }
+
+  Point operator[](long i) {
+    return Point(codes.get() + i * M, nullptr, M, i);
+  }
+
+  // The query point for q, with its distance table.  The table belongs to
+  // the calling thread and is overwritten by its next call.
+  Point query(FullPoint q) {
+    static thread_local std::vector<float> table;
+    static thread_local std::vector<float> v;
+    table.resize((size_t)M * PQ_CENTROIDS);
+    v.resize(dims);
+    for (unsigned j = 0; j < dims; j++) v[j] = q[j];
+    for (unsigned m = 0; m < M; m++) {
+      unsigned d = start(m + 1) - start(m);
+      const float* qs = v.data() + start(m);
+      for (unsigned c = 0; c < K; c++) {
+        const float* cs = centroid(m, c);
+        float r = 0;
+        if (FullPoint::is_metric()) {
+          for (unsigned j = 0; j < d; j++) r += (qs[j] - cs[j]) * (qs[j] - cs[j]);
+        } else {
+          for (unsigned j = 0; j < d; j++) r -= qs[j] * cs[j];
+        }
+        table[m * PQ_CENTROIDS + c] = r;
+      }
+    }
+    return Point(nullptr, table.data(), M, q.id());
+  }
+
+  template <typename indexType>
+  void distance_batch(Point q, const indexType* ids, size_t m, float* out) {
+    q.distance_batch(codes.get(), M, ids, m, out);
+  }
+
+  // table lookups over M codes are too short to stop early
+  template <typename indexType>
+  void distance_batch_bounded(Point q, const indexType* ids, size_t m,
+                              const float* bounds, float* out) {
+    q.distance_batch(codes.get(), M, ids, m, out);
+  }
+
+ private:
+  size_t n;
+  unsigned dims;
+  unsigned M;
+  unsigned K;
+  // centroid c of subspace m is at centroids + start(m) * K + c * (its
+  // dimension)
+  std::shared_ptr<float[]> centroids;
+  std::shared_ptr<uint8_t[]> codes;
+
+  unsigned start(unsigned m) { return (m * dims) / M; }
+
+  float* centroid(unsigned m, unsigned c) {
+    return centroids.get() + (size_t)start(m) * K +
+           (size_t)c * (start(m + 1) - start(m));
+  }
+
+  uint8_t nearest_centroid(const float* v, unsigned m) {
+    unsigned d = start(m + 1) - start(m);
+    float best = std::numeric_limits<float>::max();
+    unsigned arg = 0;
+    for (unsigned c = 0; c < K; c++) {
+      const float* cs = centroid(m, c);
+      float r = 0;
+      for (unsigned j = 0; j < d; j++) r += (v[j] - cs[j]) * (v[j] - cs[j]);
+      if (r < best) {
+        best = r;
+        arg = c;
+      }
+    }
+    return arg;
+  }
+
+  // Lloyd's k-means on the coordinates of subspace m, starting from
+  // training points spread evenly over the set.  An empty cluster is
+  // restarted at a training point.
+  void train_subspace(parlay::sequence<float>& train, size_t t, unsigned m,
+                      int iters) {
+    unsigned s = start(m), d = start(m + 1) - start(m);
+    for (unsigned c = 0; c < K; c++)
+      for (unsigned j = 0; j < d; j++)
+        centroid(m, c)[j] = train[((c * t) / K) * dims + s + j];
+    parlay::sequence<uint8_t> assign(t);
+    for (int it = 0; it < iters; it++) {
+      parlay::parallel_for(0, t, [&](size_t i) {
+        assign[i] = nearest_centroid(train.begin() + i * dims + s, m);
+      });
+      std::vector<double> sums((size_t)K * d, 0);
+      std::vector<size_t> counts(K, 0);
+      for (size_t i = 0; i < t; i++) {
+        counts[assign[i]]++;
+        for (unsigned j = 0; j < d; j++)
+          sums[assign[i] * d + j] += train[i * dims + s + j];
+      }
+      for (unsigned c = 0; c < K; c++) {
+        size_t r = (c * 7919 + it * 104729) % t;
+        for (unsigned j = 0; j < d; j++)
+          centroid(m, c)[j] = counts[c] == 0
+                                  ? train[r * dims + s + j]
+                                  : (float)(sums[c * d + j] / counts[c]);
+      }
+    }
+  }
+};
@@ -0,0 +1,197 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "sq_kernels.h"
+
+// Scalar quantized points.  Each dimension j has its own scale s_j and
+// zero point z_j, fitted to the range of the coordinates of the base
+// points in that dimension, and coordinate x_j is stored as the code c_j
+// in [0, 2^Bits) nearest to x_j / s_j + z_j.  8 bit codes take a quarter
+// and 4 bit codes an eighth of the memory of float vectors.
+//
+// A PointRange over these points quantizes a float file as it is read,
+// and a PointRange of queries read with PointRange(file, Base) keeps the
+// queries in float, transformed once so that each distance to a coded
+// point is a single pass of the asymmetric kernels in sq_kernels.h.
+// Distances between two coded points, which graph construction uses,
+// are symmetric.
+
+template <int Bits>
+struct scalar_quantizer {
+  static_assert(Bits == 8 || Bits == 4, "codes have 8 or 4 bits");
+  static constexpr int levels = (1 << Bits) - 1;
+
+  unsigned dims;
+  // dims rounded up so that a row of codes is a multiple of 64 bytes
+  unsigned padded_dims;
+  // padded dimensions have scale 1, zero point 0 and weight 0
+  std::vector<float> scale, zero, weight;
+
+  scalar_quantizer() : dims(0), padded_dims(0) {}
+
+  // from the smallest and largest coordinate in each dimension
+  scalar_quantizer(const std::vector<float>& lo, const std::vector<float>& hi)
+      : dims(lo.size()), padded_dims(pad(lo.size())) {
+    scale.assign(padded_dims, 1);
+    zero.assign(padded_dims, 0);
+    weight.assign(padded_dims, 0);
+    for (unsigned j = 0; j < dims; j++) {
+      float s = (hi[j] - lo[j]) / levels;
+      scale[j] = s > 0 ? s : 1;
+      zero[j] = -lo[j] / scale[j];
+      weight[j] = scale[j] * scale[j];
+    }
+  }
+
+  static unsigned pad(unsigned d) {
+    unsigned block = 512 / Bits;
+    return ((d + block - 1) / block) * block;
+  }
+
+  size_t row_bytes() const { return (size_t)padded_dims * Bits / 8; }
+
+  void encode(const float* x, uint8_t* row) const {
+    std::memset(row, 0, row_bytes());
+    for (unsigned j = 0; j < dims; j++) {
+      float c = std::nearbyint(x[j] / scale[j] + zero[j]);
+      int code = (int)std::min<float>(std::max<float>(c, 0), levels);
+      if (Bits == 8) {
+        row[j] = code;
+      } else {
+        unsigned i = j % 32;
+        row[(j / 32) * 16 + (i % 16)] |= (i < 16) ? code : code << 4;
+      }
+    }
+  }
+
+  float decode(const uint8_t* row, unsigned j) const {
+    return scale[j] * (sq_code<Bits>(row, j) - zero[j]);
+  }
+
+  // a transformed query takes padded_dims floats and one more for mips
+  size_t query_floats() const { return padded_dims + 16; }
+};
+
+template <int Bits, bool L2>
+struct Quantized_Point {
+  using distanceType = float;
+  using Quantizer = scalar_quantizer<Bits>;
+
+  static distanceType d_min() {
+    return L2 ? 0 : -std::numeric_limits<float>::max();
+  }
+  static bool is_metric() { return L2; }
+
+  float operator[](long j) {
+    if (query == nullptr) return Q->decode(values, j);
+    return L2 ? (query[j] - Q->zero[j]) * Q->scale[j] : query[j] / Q->scale[j];
+  }
+
+  // symmetric between two coded points, asymmetric if either is a query
+  float distance(Quantized_Point x) {
+    if (query != nullptr) return query_distance(x.values);
+    if (x.query != nullptr) return x.query_distance(values);
+    const sq_kernel_table& K = sq_kernels<Bits>();
+    if (L2) return K.l2_codes(Q->weight.data(), values, x.values, Q->padded_dims);
+    return -K.dot_codes(Q->weight.data(), Q->zero.data(), values, x.values,
+                        Q->padded_dims);
+  }
+
+  // distances to the rows base + ids[j] * stride for j < m
+  template <typename indexType>
+  void distance_batch(const uint8_t* base, size_t stride,
+                      const indexType* ids, size_t m, float* out) {
+    for (size_t j = 0; j < m; j++) {
+      if (j + 4 < m) prefetch_row(base + ids[j + 4] * stride, stride);
+      Quantized_Point x(base + ids[j] * stride, d, aligned_d, ids[j], Q);
+      out[j] = distance(x);
+    }
+  }
+
+  void prefetch() {
+    if (values != nullptr) prefetch_row(values, aligned_d);
+  }
+
+  long id() { return id_; }
+
+  // query, if not null, is a float query transformed by transform_query
+  Quantized_Point(const uint8_t* values, unsigned int d, unsigned int ad,
+                  long id, const Quantizer* Q, const float* query = nullptr)
+      : values(values), d(d), aligned_d(ad), id_(id), Q(Q), query(query) {}
+
+  bool operator==(Quantized_Point q) {
+    if (query != nullptr || q.query != nullptr) {
+      for (unsigned j = 0; j < d; j++)
+        if ((*this)[j] != q[j]) return false;
+      return true;
+    }
+    return std::memcmp(values, q.values, aligned_d) == 0;
+  }
+
+  // Writes Q.query_floats() floats to out.  For Euclidian distance the
+  // query is moved into code space, u_j = q_j / s_j + z_j, so that the
+  // distance is sum_j s_j^2 (u_j - c_j)^2.  For mips the coordinates are
+  // scaled, v_j = q_j s_j, and the inner product is
+  // sum_j v_j c_j - sum_j v_j z_j, whose second term is stored after the
+  // padded dimensions.
+  static void transform_query(const Quantizer& Q, const float* q,
+                              float* out) {
+    std::fill(out, out + Q.query_floats(), 0.0f);
+    float offset = 0;
+    for (unsigned j = 0; j < Q.dims; j++) {
+      out[j] = L2 ? q[j] / Q.scale[j] + Q.zero[j] : q[j] * Q.scale[j];
+      offset -= out[j] * Q.zero[j];
+    }
+    if (!L2) out[Q.padded_dims] = offset;
+  }
+
+ private:
+  const uint8_t* values;
+  unsigned int d;
+  unsigned int aligned_d;
+  long id_;
+  const Quantizer* Q;
+  const float* query;
+
+  float query_distance(const uint8_t* c) {
+    const sq_kernel_table& K = sq_kernels<Bits>();
+    if (L2) return K.l2_float(Q->weight.data(), query, c, Q->padded_dims);
+    return -(K.dot_float(query, c, Q->padded_dims) + query[Q->padded_dims]);
+  }
+};
+
+template <int Bits>
+using Quantized_Euclidian_Point = Quantized_Point<Bits, true>;
+
+template <int Bits>
+using Quantized_Mips_Point = Quantized_Point<Bits, false>;
@@ -0,0 +1,106 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "beamSearch.h"
+#include "graph.h"
+#include "stats.h"
+#include "types.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+
+// All the points within distance radius of p, closest first, and the
+// number of distance comparisons and visited vertices.  It runs beam_search
+// with QP's beam width and, while the whole final beam is within the
+// radius, so that more matches may lie past it, runs it again from the
+// beam with twice the width, up to max_beam.  The matches are those of
+// the visited vertices and beams of every round.  QP.k is ignored, since
+// the cut it sets for top-k searches would drop matches.
+template<typename Point, typename PointRange, typename indexType,
+         typename GraphType = Graph<indexType>>
+std::pair<parlay::sequence<std::pair<indexType, typename Point::distanceType>>,
+          std::pair<size_t, size_t>>
+range_search(Point p, GraphType &G, PointRange &Points,
+             parlay::sequence<indexType> starting_points, double radius,
+             QueryParams &QP, long max_beam) {
+  using distanceType = typename Point::distanceType;
+  using pid = std::pair<indexType, distanceType>;
+  auto &ctx = local_search_context<indexType, distanceType>();
+  QueryParams RQ = QP;
+  RQ.k = 0;
+  parlay::sequence<indexType> starts = starting_points;
+  std::vector<pid> found;
+  size_t dist_cmps = 0;
+  size_t num_visited = 0;
+  while (true) {
+    auto [pairElts, cmps] =
+        beam_search(p, G, Points, parlay::make_slice(starts), RQ, ctx);
+    auto [frontier, visited] = pairElts;
+    dist_cmps += cmps;
+    num_visited += visited.size();
+    for (auto v : visited)
+      if (v.second <= radius) found.push_back(v);
+    for (auto f : frontier)
+      if (f.second <= radius) found.push_back(f);
+    bool full = (frontier.size() >= (size_t)RQ.beamSize &&
+                 frontier[frontier.size() - 1].second <= radius);
+    if (!full || RQ.beamSize >= max_beam) break;
+    starts = parlay::tabulate(frontier.size(),
+                              [&](size_t i) { return frontier[i].first; });
+    RQ.beamSize = std::min<long>(2 * RQ.beamSize, max_beam);
+  }
+
+  // a vertex can be found in several rounds, and in both the beam and the
+  // visited set of one
+  std::sort(found.begin(), found.end());
+  found.erase(std::unique(found.begin(), found.end(),
+                          [](pid a, pid b) { return a.first == b.first; }),
+              found.end());
+  std::sort(found.begin(), found.end(), [](pid a, pid b) {
+    return a.second < b.second || (a.second == b.second && a.first < b.first);
+  });
+  return std::make_pair(parlay::to_sequence(found),
+                        std::make_pair(dist_cmps, num_visited));
+}
+
+// range_search from starting_point for every query, in parallel
+template<typename Point, typename PointRange, typename indexType>
+parlay::sequence<parlay::sequence<indexType>> searchAllRange(
+    PointRange &Query_Points, Graph<indexType> &G, PointRange &Base_Points,
+    stats<indexType> &QueryStats, indexType starting_point, double radius,
+    QueryParams &QP, long max_beam) {
+  parlay::sequence<indexType> start_points = {starting_point};
+  parlay::sequence<parlay::sequence<indexType>> all_matches(Query_Points.size());
+  parlay::parallel_for(0, Query_Points.size(), [&](size_t i) {
+    auto [matches, counts] = range_search<Point, PointRange, indexType>(
+        Query_Points[i], G, Base_Points, start_points, radius, QP, max_beam);
+    all_matches[i] = parlay::map(matches, [](auto m) { return m.first; });
+    QueryStats.increment_dist(i, counts.first);
+    QueryStats.increment_visited(i, counts.second);
+  });
+  return all_matches;
+}
@@ -0,0 +1,243 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "graph.h"
+#include "parallel_io.h"
+
+// Vertex orders that give vertices which are visited close together by a
+// search nearby ids, so that their adjacency lists and vectors share pages
+// and cache lines.  An order is a permutation where order[i] is the
+// original id of the vertex that is given id i.  Every order puts start
+// first, so ordering from the graph's start point makes it vertex 0;
+// Graph::permute keeps the start point in its new id either way.  The
+// order doubles as the id map that translates search results back to the
+// original ids; see write_id_map.
+
+template <typename indexType>
+parlay::sequence<indexType> inverse_permutation(
+    const parlay::sequence<indexType> &order) {
+  parlay::sequence<indexType> new_id(order.size());
+  parlay::parallel_for(0, order.size(),
+                       [&](size_t i) { new_id[order[i]] = i; });
+  return new_id;
+}
+
+// in-neighbors of every vertex, as offsets into a flat array of ids
+template <typename indexType>
+std::pair<parlay::sequence<size_t>, parlay::sequence<indexType>> in_neighbors(
+    Graph<indexType> &G) {
+  size_t n = G.size();
+  parlay::sequence<size_t> offsets(n + 1, 0);
+  for (size_t i = 0; i < n; i++)
+    for (indexType j = 0; j < G[i].size(); j++) offsets[G[i][j] + 1]++;
+  for (size_t i = 0; i < n; i++) offsets[i + 1] += offsets[i];
+  parlay::sequence<indexType> sources(offsets[n]);
+  parlay::sequence<size_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < n; i++)
+    for (indexType j = 0; j < G[i].size(); j++) sources[fill[G[i][j]]++] = i;
+  return std::make_pair(std::move(offsets), std::move(sources));
+}
+
+// Breadth first order from start, following out-edges with neighbors taken
+// in the order given by next.  Vertices that cannot be reached from start
+// follow in further searches from the lowest unvisited id.
+template <typename indexType, typename F>
+parlay::sequence<indexType> breadth_first(Graph<indexType> &G, indexType start,
+                                          F &&next) {
+  size_t n = G.size();
+  parlay::sequence<indexType> order;
+  order.reserve(n);
+  std::vector<bool> visited(n, false);
+  size_t lowest = 0;
+  indexType source = start;
+  while (true) {
+    size_t head = order.size();
+    visited[source] = true;
+    order.push_back(source);
+    while (head < order.size()) {
+      for (indexType v : next(order[head++])) {
+        if (!visited[v]) {
+          visited[v] = true;
+          order.push_back(v);
+        }
+      }
+    }
+    while (lowest < n && visited[lowest]) lowest++;
+    if (lowest == n) break;
+    source = lowest;
+  }
+  return order;
+}
+
+template <typename indexType>
+parlay::sequence<indexType> bfs_order(Graph<indexType> &G, indexType start) {
+  return breadth_first(G, start, [&](indexType u) {
+    return parlay::tabulate(G[u].size(), [&](size_t j) { return G[u][j]; });
+  });
+}
+
+// Reverse Cuthill-McKee: a breadth first order that visits the neighbors
+// of each vertex from the lowest to the highest degree, counting in- and
+// out-edges, reversed.  start is then moved back to the front.
+template <typename indexType>
+parlay::sequence<indexType> rcm_order(Graph<indexType> &G, indexType start) {
+  auto [offsets, sources] = in_neighbors(G);
+  auto degree = [&, &offsets = offsets](indexType v) {
+    return G[v].size() + offsets[v + 1] - offsets[v];
+  };
+  auto order = breadth_first(G, start, [&](indexType u) {
+    auto nbhs =
+        parlay::tabulate(G[u].size(), [&](size_t j) { return G[u][j]; });
+    std::stable_sort(nbhs.begin(), nbhs.end(), [&](indexType a, indexType b) {
+      return degree(a) < degree(b);
+    });
+    return nbhs;
+  });
+  std::reverse(order.begin(), order.end());
+  std::rotate(order.begin(), order.end() - 1, order.end());
+  return order;
+}
+
+// Gorder (Wei et al., SIGMOD 2016) places next the vertex with the most
+// edges to, and in-neighbors in common with, the last window placed
+// vertices.  Scores change by one at a time, so they are kept in buckets of
+// equal score with a pointer to the highest nonempty one.  This is
+// sequential and its cost grows with the product of in- and out-degrees,
+// so it is much slower than bfs_order and rcm_order.
+template <typename indexType>
+parlay::sequence<indexType> gorder(Graph<indexType> &G, indexType start,
+                                   long window = 5) {
+  long n = G.size();
+  auto [offsets, sources] = in_neighbors(G);
+  std::vector<long> score(n, 0), prev(n), next(n), head(1, -1);
+  std::vector<bool> placed(n, false);
+  long top = 0;
+
+  auto remove = [&](long v) {
+    if (prev[v] == -1) head[score[v]] = next[v];
+    else next[prev[v]] = next[v];
+    if (next[v] != -1) prev[next[v]] = prev[v];
+  };
+  auto insert = [&](long v) {
+    if (score[v] >= (long)head.size()) head.resize(score[v] + 1, -1);
+    prev[v] = -1;
+    next[v] = head[score[v]];
+    if (next[v] != -1) prev[next[v]] = v;
+    head[score[v]] = v;
+    top = std::max(top, score[v]);
+  };
+  auto change = [&](long v, long delta) {
+    if (placed[v]) return;
+    remove(v);
+    score[v] += delta;
+    insert(v);
+  };
+  // the vertices whose scores count v: its out-neighbors, its
+  // in-neighbors, and the other out-neighbors of its in-neighbors
+  auto update = [&, &offsets = offsets, &sources = sources](long v,
+                                                            long delta) {
+    for (indexType j = 0; j < G[v].size(); j++) change(G[v][j], delta);
+    for (size_t e = offsets[v]; e < offsets[v + 1]; e++) {
+      indexType x = sources[e];
+      change(x, delta);
+      for (indexType j = 0; j < G[x].size(); j++)
+        if (G[x][j] != v) change(G[x][j], delta);
+    }
+  };
+
+  for (long v = n - 1; v >= 0; v--) insert(v);
+  parlay::sequence<indexType> order(n);
+  for (long i = 0; i < n; i++) {
+    long v = start;
+    if (i > 0) {
+      while (head[top] == -1) top--;
+      v = head[top];
+    }
+    remove(v);
+    placed[v] = true;
+    order[i] = v;
+    update(v, 1);
+    if (i >= window) update(order[i - window], -1);
+  }
+  return order;
+}
+
+template <typename indexType>
+parlay::sequence<indexType> vertex_order(Graph<indexType> &G,
+                                         std::string method,
+                                         indexType start) {
+  if (method == "bfs") return bfs_order(G, start);
+  if (method == "rcm") return rcm_order(G, start);
+  if (method == "gorder") return gorder(G, start);
+  std::cout << "ERROR: unknown vertex order " << method
+            << ", specify bfs, rcm or gorder" << std::endl;
+  abort();
+}
+
+// The id map is stored like a point file of dimension one, holding the
+// original id of each vertex of the reordered graph.
+template <typename indexType>
+void write_id_map(char *oFile, const parlay::sequence<indexType> &order) {
+  unsigned int preamble[2] = {static_cast<unsigned int>(order.size()), 1};
+  parallel_file writer(oFile, true);
+  writer.write(preamble, 2 * sizeof(unsigned int), 0);
+  writer.write(order.begin(), order.size() * sizeof(indexType),
+               2 * sizeof(unsigned int));
+  writer.report();
+}
+
+template <typename indexType>
+parlay::sequence<indexType> read_id_map(char *iFile) {
+  unsigned int preamble[2];
+  parallel_file reader(iFile, false);
+  reader.read(preamble, 2 * sizeof(unsigned int), 0);
+  if (preamble[1] != 1 ||
+      reader.size() != 2 * sizeof(unsigned int) + preamble[0] * sizeof(indexType)) {
+    std::cout << "ERROR: " << iFile << " is not an id map" << std::endl;
+    abort();
+  }
+  parlay::sequence<indexType> order(preamble[0]);
+  reader.read(order.begin(), order.size() * sizeof(indexType),
+              2 * sizeof(unsigned int));
+  return order;
+}
+
+// translates ids of a reordered graph back to the original ids, leaving
+// the -1 that pads results shorter than k
+template <typename indexType>
+void to_original_ids(parlay::sequence<parlay::sequence<indexType>> &results,
+                     const parlay::sequence<indexType> &id_map) {
+  parlay::parallel_for(0, results.size(), [&](size_t i) {
+    for (indexType &id : results[i])
+      if (id != (indexType)-1) id = id_map[id];
+  });
+}
@@ -0,0 +1,145 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "parlay/internal/get_time.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+
+// Chooses several start points for each query instead of one.  At build
+// time the centroids of a k-means clustering of a sample of the points are
+// each mapped to the closest sampled point; these are the entries.  A
+// query measures its distance to every entry and starts the beam search
+// from the closest num_starts of them, so on data with several modes it
+// starts near its own mode rather than crossing the graph from one medoid.
+// The clustering uses Euclidian distances over the coordinates the points
+// expose with operator[], whatever distance the points use; routing a query
+// uses the points' own distance.
+template <typename indexType>
+struct entry_router {
+  parlay::sequence<indexType> entries;
+  long num_starts = 1;
+
+  entry_router() {}
+
+  template <typename PointRange>
+  entry_router(PointRange &Points, long num_entries, long num_starts,
+               size_t sample_size = 0, int rounds = 10)
+      : num_starts(std::max<long>(1, num_starts)) {
+    parlay::internal::timer t("router", false);
+    t.start();
+    size_t n = Points.size();
+    if (n == 0 || num_entries <= 0) return;
+    unsigned d = Points.dimension();
+    if (sample_size == 0)
+      sample_size = std::max<size_t>(10000, 40 * (size_t)num_entries);
+    size_t s = std::min(n, sample_size);
+    size_t m = std::min(s, (size_t)num_entries);
+
+    // the sample, evenly spaced through the points, as floats
+    std::vector<float> S(s * d);
+    parlay::parallel_for(0, s, [&](size_t i) {
+      auto p = Points[i * n / s];
+      for (unsigned j = 0; j < d; j++) S[i * d + j] = (float)p[j];
+    });
+    auto sq_dist = [&](const float *a, const float *b) {
+      float dist = 0;
+      for (unsigned j = 0; j < d; j++) {
+        float diff = a[j] - b[j];
+        dist += diff * diff;
+      }
+      return dist;
+    };
+
+    // Lloyd's algorithm from evenly spaced sample points; an emptied
+    // cluster keeps its centroid
+    std::vector<float> C(m * d);
+    for (size_t c = 0; c < m; c++)
+      std::copy(S.begin() + (c * s / m) * d, S.begin() + (c * s / m + 1) * d,
+                C.begin() + c * d);
+    std::vector<indexType> assign(s);
+    std::vector<size_t> counts(m);
+    for (int r = 0; r < rounds; r++) {
+      parlay::parallel_for(0, s, [&](size_t i) {
+        float best = std::numeric_limits<float>::max();
+        for (size_t c = 0; c < m; c++) {
+          float dist = sq_dist(&S[i * d], &C[c * d]);
+          if (dist < best) {
+            best = dist;
+            assign[i] = c;
+          }
+        }
+      });
+      std::fill(counts.begin(), counts.end(), 0);
+      for (size_t i = 0; i < s; i++) counts[assign[i]]++;
+      parlay::parallel_for(0, d, [&](size_t j) {
+        std::vector<double> sum(m, 0.0);
+        for (size_t i = 0; i < s; i++) sum[assign[i]] += S[i * d + j];
+        for (size_t c = 0; c < m; c++)
+          if (counts[c] > 0) C[c * d + j] = (float)(sum[c] / counts[c]);
+      });
+    }
+
+    // the sampled point closest to each centroid
+    auto closest = parlay::tabulate(m, [&](size_t c) {
+      size_t best_i = 0;
+      float best = std::numeric_limits<float>::max();
+      for (size_t i = 0; i < s; i++) {
+        float dist = sq_dist(&S[i * d], &C[c * d]);
+        if (dist < best) {
+          best = dist;
+          best_i = i;
+        }
+      }
+      return static_cast<indexType>(best_i * n / s);
+    });
+    entries = parlay::remove_duplicates(closest);
+    std::cout << "Entry router with " << entries.size()
+              << " entries from a sample of " << s << " points built in "
+              << t.next_time() << " seconds" << std::endl;
+  }
+
+  size_t size() { return entries.size(); }
+
+  // the entries closest to q, at most max_starts of them, using the
+  // distances of Points; the search makes size() comparisons to find them
+  template <typename Point, typename PointRange>
+  parlay::sequence<indexType> route(Point q, PointRange &Points,
+                                    long max_starts) {
+    using distanceType = typename Point::distanceType;
+    size_t m = entries.size();
+    std::vector<distanceType> dists(m);
+    Points.distance_batch(q, entries.data(), m, dists.data());
+    std::vector<std::pair<distanceType, indexType>> order(m);
+    for (size_t i = 0; i < m; i++) order[i] = {dists[i], entries[i]};
+    size_t starts = std::min<size_t>(m, std::min(num_starts, max_starts));
+    std::partial_sort(order.begin(), order.begin() + starts, order.end());
+    return parlay::tabulate(starts, [&](size_t i) { return order[i].second; });
+  }
+};
@@ -0,0 +1,319 @@
+// This code is part of the Problem Based Benchmark Suite (PBBS)
+// Copyright (c) 2011 Guy Blelloch and the PBBS team
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights (to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "distance_kernels.h"
+
+// Kernels for vectors scalar quantized to 8 or 4 bit codes, see
+// quantized_point.h.  Coordinate j of a vector is s_j (c_j - z_j) for
+// per-dimension scales s and zero points z, so every distance is a sum
+// over dimensions of a per-dimension weight times an integer expression
+// of the codes, and no coordinate is rebuilt inside the loops:
+//
+//   l2_codes   sum_j w_j (a_j - b_j)^2          (w = s^2)
+//   dot_codes  sum_j w_j (a_j - z_j)(b_j - z_j)
+//   l2_float   sum_j w_j (u_j - c_j)^2          (u = q / s + z)
+//   dot_float  sum_j v_j c_j                    (v = q s)
+//
+// The first two compare two coded vectors, the last two a float query,
+// transformed once per query, with a coded vector.  8 bit codes are one
+// byte per dimension.  4 bit codes pack each block of 32 dimensions into
+// 16 bytes, dimension i of the block in the low nibble of byte i and
+// dimension i + 16 in the high nibble, so that a block unpacks with one
+// mask and one shift.  The code differences are taken in int32 lanes
+// before the conversion to float.  All kernels take the padded dimension,
+// a multiple of 32; padded dimensions have zero weight.
+
+// *************************************************************
+//  scalar
+// *************************************************************
+
+template <int Bits>
+inline int sq_code(const uint8_t* c, unsigned j) {
+  if (Bits == 8) return c[j];
+  uint8_t b = c[(j / 32) * 16 + (j % 16)];
+  return (j % 32) < 16 ? (b & 0x0F) : (b >> 4);
+}
+
+template <int Bits>
+float sq_l2_codes_scalar(const float* w, const uint8_t* a, const uint8_t* b,
+                         unsigned d) {
+  float result = 0;
+  for (unsigned j = 0; j < d; j++) {
+    int diff = sq_code<Bits>(a, j) - sq_code<Bits>(b, j);
+    result += w[j] * (float)(diff * diff);
+  }
+  return result;
+}
+
+template <int Bits>
+float sq_dot_codes_scalar(const float* w, const float* z, const uint8_t* a,
+                          const uint8_t* b, unsigned d) {
+  float result = 0;
+  for (unsigned j = 0; j < d; j++)
+    result += w[j] * (sq_code<Bits>(a, j) - z[j]) * (sq_code<Bits>(b, j) - z[j]);
+  return result;
+}
+
+template <int Bits>
+float sq_l2_float_scalar(const float* w, const float* u, const uint8_t* c,
+                         unsigned d) {
+  float result = 0;
+  for (unsigned j = 0; j < d; j++) {
+    float diff = u[j] - sq_code<Bits>(c, j);
+    result += w[j] * diff * diff;
+  }
+  return result;
+}
+
+template <int Bits>
+float sq_dot_float_scalar(const float* v, const uint8_t* c, unsigned d) {
+  float result = 0;
+  for (unsigned j = 0; j < d; j++) result += v[j] * sq_code<Bits>(c, j);
+  return result;
+}
+
+// *************************************************************
+//  AVX2
+// *************************************************************
+
+// codes j .. j + 31 in four int32 vectors
+template <int Bits>
+TARGET_AVX2 inline void sq_load32_avx2(const uint8_t* c, unsigned j,
+                                       __m256i* out) {
+  if (Bits == 8) {
+    for (int l = 0; l < 4; l++)
+      out[l] = _mm256_cvtepu8_epi32(
+          _mm_loadl_epi64((const __m128i*)(c + j + 8 * l)));
+  } else {
+    __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i x = _mm_loadu_si128((const __m128i*)(c + j / 2));
+    __m128i lo = _mm_and_si128(x, mask);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+    out[0] = _mm256_cvtepu8_epi32(lo);
+    out[1] = _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8));
+    out[2] = _mm256_cvtepu8_epi32(hi);
+    out[3] = _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8));
+  }
+}
+
+template <int Bits>
+TARGET_AVX2 float sq_l2_codes_avx2(const float* w, const uint8_t* a,
+                                   const uint8_t* b, unsigned d) {
+  __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),
+                   _mm256_setzero_ps(), _mm256_setzero_ps()};
+  for (unsigned j = 0; j < d; j += 32) {
+    __m256i ca[4], cb[4];
+    sq_load32_avx2<Bits>(a, j, ca);
+    sq_load32_avx2<Bits>(b, j, cb);
+    for (int l = 0; l < 4; l++) {
+      __m256i diff = _mm256_sub_epi32(ca[l], cb[l]);
+      __m256 sq = _mm256_cvtepi32_ps(_mm256_mullo_epi32(diff, diff));
+      acc[l] = _mm256_fmadd_ps(_mm256_loadu_ps(w + j + 8 * l), sq, acc[l]);
+    }
+  }
+  return hsum_avx2(_mm256_add_ps(_mm256_add_ps(acc[0], acc[1]),
+                                 _mm256_add_ps(acc[2], acc[3])));
+}
+
+template <int Bits>
+TARGET_AVX2 float sq_dot_codes_avx2(const float* w, const float* z,
+                                    const uint8_t* a, const uint8_t* b,
+                                    unsigned d) {
+  __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),
+                   _mm256_setzero_ps(), _mm256_setzero_ps()};
+  for (unsigned j = 0; j < d; j += 32) {
+    __m256i ca[4], cb[4];
+    sq_load32_avx2<Bits>(a, j, ca);
+    sq_load32_avx2<Bits>(b, j, cb);
+    for (int l = 0; l < 4; l++) {
+      __m256 zl = _mm256_loadu_ps(z + j + 8 * l);
+      __m256 x = _mm256_sub_ps(_mm256_cvtepi32_ps(ca[l]), zl);
+      __m256 y = _mm256_sub_ps(_mm256_cvtepi32_ps(cb[l]), zl);
+      acc[l] = _mm256_fmadd_ps(
+          _mm256_mul_ps(_mm256_loadu_ps(w + j + 8 * l), x), y, acc[l]);
+    }
+  }
+  return hsum_avx2(_mm256_add_ps(_mm256_add_ps(acc[0], acc[1]),
+                                 _mm256_add_ps(acc[2], acc[3])));
+}
+
+template <int Bits>
+TARGET_AVX2 float sq_l2_float_avx2(const float* w, const float* u,
+                                   const uint8_t* c, unsigned d) {
+  __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),
+                   _mm256_setzero_ps(), _mm256_setzero_ps()};
+  for (unsigned j = 0; j < d; j += 32) {
+    __m256i cc[4];
+    sq_load32_avx2<Bits>(c, j, cc);
+    for (int l = 0; l < 4; l++) {
+      __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(u + j + 8 * l),
+                                  _mm256_cvtepi32_ps(cc[l]));
+      acc[l] = _mm256_fmadd_ps(
+          _mm256_mul_ps(_mm256_loadu_ps(w + j + 8 * l), diff), diff, acc[l]);
+    }
+  }
+  return hsum_avx2(_mm256_add_ps(_mm256_add_ps(acc[0], acc[1]),
+                                 _mm256_add_ps(acc[2], acc[3])));
+}
+
+template <int Bits>
+TARGET_AVX2 float sq_dot_float_avx2(const float* v, const uint8_t* c,
+                                    unsigned d) {
+  __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(),
+                   _mm256_setzero_ps(), _mm256_setzero_ps()};
+  for (unsigned j = 0; j < d; j += 32) {
+    __m256i cc[4];
+    sq_load32_avx2<Bits>(c, j, cc);
+    for (int l = 0; l < 4; l++)
+      acc[l] = _mm256_fmadd_ps(_mm256_loadu_ps(v + j + 8 * l),
+                               _mm256_cvtepi32_ps(cc[l]), acc[l]);
+  }
+  return hsum_avx2(_mm256_add_ps(_mm256_add_ps(acc[0], acc[1]),
+                                 _mm256_add_ps(acc[2], acc[3])));
+}
+
+// *************************************************************
+//  AVX-512
+// *************************************************************
+
+// codes j .. j + 31 in two int32 vectors
+template <int Bits>
+TARGET_AVX512 inline void sq_load32_avx512(const uint8_t* c, unsigned j,
+                                           __m512i* out) {
+  if (Bits == 8) {
+    out[0] = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)(c + j)));
+    out[1] =
+        _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)(c + j + 16)));
+  } else {
+    __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i x = _mm_loadu_si128((const __m128i*)(c + j / 2));
+    out[0] = _mm512_cvtepu8_epi32(_mm_and_si128(x, mask));
+    out[1] = _mm512_cvtepu8_epi32(_mm_and_si128(_mm_srli_epi16(x, 4), mask));
+  }
+}
+
+template <int Bits>
+TARGET_AVX512 float sq_l2_codes_avx512(const float* w, const uint8_t* a,
+                                       const uint8_t* b, unsigned d) {
+  __m512 acc[2] = {_mm512_setzero_ps(), _mm512_setzero_ps()};
+  for (unsigned j = 0; j < d; j += 32) {
+    __m512i ca[2], cb[2];
+    sq_load32_avx512<Bits>(a, j, ca);
+    sq_load32_avx512<Bits>(b, j, cb);
+    for (int l = 0; l < 2; l++) {
+      __m512i diff = _mm512_sub_epi32(ca[l], cb[l]);
+      __m512 sq = _mm512_cvtepi32_ps(_mm512_mullo_epi32(diff, diff));
+      acc[l] = _mm512_fmadd_ps(_mm512_loadu_ps(w + j + 16 * l), sq, acc[l]);
+    }
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc[0], acc[1]));
+}
+
+template <int Bits>
+TARGET_AVX512 float sq_dot_codes_avx512(const float* w, const float* z,
+                                        const uint8_t* a, const uint8_t* b,
+                                        unsigned d) {
+  __m512 acc[2] = {_mm512_setzero_ps(), _mm512_setzero_ps()};
+  for (unsigned j = 0; j < d; j += 32) {
+    __m512i ca[2], cb[2];
+    sq_load32_avx512<Bits>(a, j, ca);
+    sq_load32_avx512<Bits>(b, j, cb);
+    for (int l = 0; l < 2; l++) {
+      __m512 zl = _mm512_loadu_ps(z + j + 16 * l);
+      __m512 x = _mm512_sub_ps(_mm512_cvtepi32_ps(ca[l]), zl);
+      __m512 y = _mm512_sub_ps(_mm512_cvtepi32_ps(cb[l]), zl);
+      acc[l] = _mm512_fmadd_ps(
+          _mm512_mul_ps(_mm512_loadu_ps(w + j + 16 * l), x), y, acc[l]);
+    }
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc[0], acc[1]));
+}
+
+template <int Bits>
+TARGET_AVX512 float sq_l2_float_avx512(const float* w, const float* u,
+                                       const uint8_t* c, unsigned d) {
+  __m512 acc[2] = {_mm512_setzero_ps(), _mm512_setzero_ps()};
+  for (unsigned j = 0; j < d; j += 32) {
+    __m512i cc[2];
+    sq_load32_avx512<Bits>(c, j, cc);
+    for (int l = 0; l < 2; l++) {
+      __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(u + j + 16 * l),
+                                  _mm512_cvtepi32_ps(cc[l]));
+      acc[l] = _mm512_fmadd_ps(
+          _mm512_mul_ps(_mm512_loadu_ps(w + j + 16 * l), diff), diff, acc[l]);
+    }
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc[0], acc[1]));
+}
+
+template <int Bits>
+TARGET_AVX512 float sq_dot_float_avx512(const float* v, const uint8_t* c,
+                                        unsigned d) {
+  __m512 acc[2] = {_mm512_setzero_ps(), _mm512_setzero_ps()};
+  for (unsigned j = 0; j < d; j += 32) {
+    __m512i cc[2];
+    sq_load32_avx512<Bits>(c, j, cc);
+    for (int l = 0; l < 2; l++)
+      acc[l] = _mm512_fmadd_ps(_mm512_loadu_ps(v + j + 16 * l),
+                               _mm512_cvtepi32_ps(cc[l]), acc[l]);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc[0], acc[1]));
+}
+
+// *************************************************************
+//  kernel table and runtime selection
+// *************************************************************
+
+struct sq_kernel_table {
+  DistanceISA isa;
+  float (*l2_codes)(const float*, const uint8_t*, const uint8_t*, unsigned);
+  float (*dot_codes)(const float*, const float*, const uint8_t*,
+                     const uint8_t*, unsigned);
+  float (*l2_float)(const float*, const float*, const uint8_t*, unsigned);
+  float (*dot_float)(const float*, const uint8_t*, unsigned);
+};
+
+// SSE2 uses the scalar kernels and VNNI the AVX-512 ones, since the
+// weights leave no exact integer sums for vpdpbusd to compute
+template <int Bits>
+inline sq_kernel_table select_sq_kernels() {
+  static const sq_kernel_table tables[] = {
+      {ISA_SCALAR, sq_l2_codes_scalar<Bits>, sq_dot_codes_scalar<Bits>,
+       sq_l2_float_scalar<Bits>, sq_dot_float_scalar<Bits>},
+      {ISA_AVX2, sq_l2_codes_avx2<Bits>, sq_dot_codes_avx2<Bits>,
+       sq_l2_float_avx2<Bits>, sq_dot_float_avx2<Bits>},
+      {ISA_AVX512, sq_l2_codes_avx512<Bits>, sq_dot_codes_avx512<Bits>,
+       sq_l2_float_avx512<Bits>, sq_dot_float_avx512<Bits>}};
+  DistanceISA isa = selected_isa();
+  if (isa >= ISA_AVX512) return tables[2];
+  if (isa >= ISA_AVX2) return tables[1];
+  return tables[0];
+}
+
+// probes the CPU on the first call
+template <int Bits>
+inline const sq_kernel_table& sq_kernels() {
+  static const sq_kernel_table table = select_sq_kernels<Bits>();
+  return table;
+}
@@ -28,6 +28,7 @@
 #include "parlay/parallel.h"
 #include "parlay/primitives.h"
 #include "mmap.h"
+#include "parallel_io.h"
 
 template<typename T>
 struct groundTruth{
@@ -81,12 +82,11 @@ struct groundTruth{
      std::cout << "Writing groundtruth for " << n << " points and num results " << dim
                     << std::endl;
       parlay::sequence<T> preamble = {static_cast<T>(n), static_cast<T>(dim)};
-      std::ofstream writer;
-      writer.open(save_path, std::ios::binary | std::ios::out);
-      writer.write((char*)preamble.begin(), 2 * sizeof(T));
-      writer.write((char*)coords.begin(), dim*n*sizeof(T));
-      writer.write((char*)dists.begin(), dim*n*sizeof(float));
-      writer.close();
+      parallel_file writer(save_path, true);
+      writer.write(preamble.begin(), 2 * sizeof(T), 0);
+      writer.write(coords.begin(), dim*n*sizeof(T), 2 * sizeof(T));
+      writer.write(dists.begin(), dim*n*sizeof(float), 2 * sizeof(T) + dim*n*sizeof(T));
+      writer.report();
   }
 
   T coordinates(long i, long j){return *(coords.begin() + i*dim + j);}
@@ -99,6 +99,54 @@ struct groundTruth{
 
 };
 
+// Ground truth for range searches, in the format of the range tasks of
+// big-ann-benchmarks: the number of queries and the total number of
+// matches, then the number of matches of each query, then the ids of all
+// the matches and then their distances, query after query.
+template<typename T>
+struct RangeGroundTruth{
+  size_t n = 0;
+  size_t total = 0;
+  parlay::sequence<size_t> offsets;
+  parlay::slice<T*, T*> ids;
+  parlay::slice<float*, float*> dists;
+
+  RangeGroundTruth() : ids(parlay::make_slice<T*, T*>(nullptr, nullptr)),
+    dists(parlay::make_slice<float*, float*>(nullptr, nullptr)){}
+
+  RangeGroundTruth(char* gtFile) : ids(parlay::make_slice<T*, T*>(nullptr, nullptr)),
+    dists(parlay::make_slice<float*, float*>(nullptr, nullptr)){
+      if(gtFile == NULL) return;
+      auto [fileptr, length] = mmapStringFromFile(gtFile);
+      n = *((T*) fileptr);
+      total = *((T*) (fileptr+4));
+      if(length != 8 + n*sizeof(T) + total*(sizeof(T) + sizeof(float))){
+        std::cout << "ERROR: " << gtFile << " is not a range ground truth file" << std::endl;
+        abort();
+      }
+      std::cout << "Detected " << n << " queries with " << total << " range results" << std::endl;
+
+      T* sizes = (T*)(fileptr+8);
+      offsets = parlay::sequence<size_t>(n + 1);
+      parlay::parallel_for(0, n, [&] (size_t i){offsets[i] = sizes[i];});
+      offsets[n] = 0;
+      parlay::scan_inplace(offsets);
+      T* start_ids = sizes + n;
+      float* start_dists = (float*)(start_ids + total);
+      ids = parlay::make_slice(start_ids, start_ids + total);
+      dists = parlay::make_slice(start_dists, start_dists + total);
+  }
+
+  // the ids of the points within the radius of query i
+  parlay::slice<T*, T*> operator[](long i){
+    return parlay::make_slice(ids.begin() + offsets[i], ids.begin() + offsets[i+1]);
+  }
+
+  size_t matches(long i){return offsets[i+1] - offsets[i];}
+
+  size_t size(){return n;}
+};
+
 
 struct BuildParams{
   long L; //vamana
@@ -114,6 +162,14 @@ struct BuildParams{
 
   std::string alg_type;
 
+  // with num_entries > 0, an entry_router with that many entries is built
+  // after the graph, and each query starts from its entry_starts closest
+  long num_entries = 0;
+  long entry_starts = 4;
+  // the number of queries each worker interleaves in the benchmark
+  // searches, see searchAllInterleaved; 0 searches them one at a time
+  long interleave = 0;
+
   BuildParams(long R, long L, double a, bool tp, long nc, long cs, long mst, double de) : R(R), L(L), 
             alpha(a), two_pass(tp), num_clusters(nc), cluster_size(cs), MST_deg(mst), delta(de) {
     if(R != 0 && L != 0 && alpha != 0){alg_type = "Vamana";}
@@ -138,12 +194,37 @@ struct BuildParams{
 };
 
 
+// How beam_search remembers which vertices it has already seen.
+// FILTER is a small direct-mapped table that can forget vertices on
+// collisions (so their distances get recomputed); EPOCH and HASH are
+// exact. AUTO picks one based on the beam size and graph size.
+enum VisitedMode { VISITED_AUTO = 0, VISITED_FILTER = 1, VISITED_EPOCH = 2, VISITED_HASH = 3 };
+
 struct QueryParams{
   long k;
   long beamSize; 
   double cut;
   long limit;
   long degree_limit;
+  VisitedMode visited_mode = VISITED_AUTO;
+  // with a quantized traversal (see searchAllReranked), the number of
+  // closest beam entries re-ranked with exact distances; 0 re-ranks k
+  long rerank_k = 0;
+  // with interleave > 1, searchAll runs that many queries at a time on each
+  // worker, see searchAllInterleaved
+  long interleave = 0;
+  // adaptive termination, off when 0 and only used with k > 0: the search
+  // stops once its closest k have not changed for patience consecutive
+  // visits, or once the closest unvisited vertex on the beam is further
+  // than stop_ratio times the k-th closest distance (metric distances only)
+  long patience = 0;
+  double stop_ratio = 0;
+  // per-query budgets, off when 0: the search stops once it has made
+  // max_dist_cmps distance comparisons or deadline_us microseconds have
+  // passed since it started, and returns its beam marked as truncated (see
+  // beam_search_context::truncated)
+  long max_dist_cmps = 0;
+  long deadline_us = 0;
 
   QueryParams(long k, long Q, double cut, long limit, long dg) : k(k), beamSize(Q), cut(cut), limit(limit), degree_limit(dg) {}
 
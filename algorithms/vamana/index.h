@@ -30,7 +30,10 @@
 
 #include "../utils/NSGDist.h"
 #include "../utils/beamSearch.h"
+#include "../utils/filtered_search.h"
 #include "../utils/graph.h"
+#include "../utils/labels.h"
+#include "../utils/medoid.h"
 #include "../utils/point_range.h"
 #include "../utils/types.h"
 #include "parlay/parallel.h"
@@ -47,16 +50,23 @@ struct knn_index {
   BuildParams BP;
   std::set<indexType> delete_set;
   indexType start_point;
+  // with labels, the graph is built for filtered searches: each point is
+  // also inserted from the start points of its labels, and robustPrune
+  // keeps the edges each label's subgraph needs
+  PointLabels<indexType> *labels = nullptr;
+  parlay::sequence<indexType> label_starts;
 
-  knn_index(BuildParams &BP) : BP(BP) {}
+  knn_index(BuildParams &BP) : BP(BP), start_point(0) {}
 
   indexType get_start() { return start_point; }
 
   // robustPrune routine as found in DiskANN paper, with the exception
   // that the new candidate set is added to the field new_nbhs instead
-  // of directly replacing the out_nbh of p
+  // of directly replacing the out_nbh of p.  With labels it is the filtered
+  // prune of Filtered-DiskANN: p_star only removes a candidate p_prime if
+  // it has every label that p and p_prime share; see also reserve_labels.
   parlay::sequence<indexType> robustPrune(indexType p,
-                                          parlay::sequence<pid> &cand,
+                                          parlay::slice<pid *, pid *> cand,
                                           GraphI &G, PR &Points, double alpha,
                                           bool add = true) {
     // add out neighbors of p to the candidate set.
@@ -65,23 +75,32 @@ struct knn_index {
     for (auto x : cand) candidates.push_back(x);
 
     if (add) {
-      for (size_t i = 0; i < out_size; i++) {
-        // candidates.push_back(std::make_pair(v[p]->out_nbh[i],
-        // Points[v[p]->out_nbh[i]].distance(Points[p])));
-        candidates.push_back(
-            std::make_pair(G[p][i], Points[G[p][i]].distance(Points[p])));
-      }
+      std::vector<distanceType> out_dists(out_size);
+      Points.distance_batch(Points[p], G[p].begin(), out_size,
+                            out_dists.data());
+      for (size_t i = 0; i < out_size; i++)
+        candidates.push_back(std::make_pair(G[p][i], out_dists[i]));
     }
 
     // Sort the candidate set in reverse order according to distance from p.
     auto less = [&](pid a, pid b) { return a.second < b.second; };
     std::sort(candidates.begin(), candidates.end(), less);
+    std::vector<pid> sorted;
+    if (labels != nullptr) sorted = candidates;
 
     std::vector<indexType> new_nbhs;
     new_nbhs.reserve(BP.R);
 
     size_t candidate_idx = 0;
 
+    // the surviving candidates after p_star, and their distances to it
+    std::vector<size_t> remaining;
+    std::vector<indexType> remaining_ids;
+    std::vector<distanceType> starprime_dists;
+    remaining.reserve(candidates.size());
+    remaining_ids.reserve(candidates.size());
+    starprime_dists.resize(candidates.size());
+
     while (new_nbhs.size() < BP.R && candidate_idx < candidates.size()) {
       // Don't need to do modifications.
       int p_star = candidates[candidate_idx].first;
@@ -92,23 +111,87 @@ struct knn_index {
 
       new_nbhs.push_back(p_star);
 
+      remaining.clear();
+      remaining_ids.clear();
       for (size_t i = candidate_idx; i < candidates.size(); i++) {
         int p_prime = candidates[i].first;
         if (p_prime != -1) {
-          distanceType dist_starprime =
-              Points[p_star].distance(Points[p_prime]);
-          distanceType dist_pprime = candidates[i].second;
-          if (alpha * dist_starprime <= dist_pprime) {
-            candidates[i].first = -1;
-          }
+          remaining.push_back(i);
+          remaining_ids.push_back(p_prime);
+        }
+      }
+      // only whether alpha * dist_starprime <= dist_pprime matters, so
+      // the distances can stop early past dist_pprime / alpha, rounded up
+      for (size_t j = 0; j < remaining.size(); j++)
+        starprime_dists[j] = std::nextafter(
+            (distanceType)(candidates[remaining[j]].second / alpha),
+            std::numeric_limits<distanceType>::max());
+      Points.distance_batch_bounded(Points[p_star], remaining_ids.data(),
+                                    remaining_ids.size(),
+                                    starprime_dists.data(),
+                                    starprime_dists.data());
+      for (size_t j = 0; j < remaining.size(); j++) {
+        distanceType dist_starprime = starprime_dists[j];
+        distanceType dist_pprime = candidates[remaining[j]].second;
+        if (alpha * dist_starprime <= dist_pprime &&
+            (labels == nullptr ||
+             labels->covers(p_star, p, candidates[remaining[j]].first))) {
+          candidates[remaining[j]].first = -1;
         }
       }
     }
 
+    if (labels != nullptr) reserve_labels(p, sorted, Points, alpha, new_nbhs);
     auto new_neighbors_seq = parlay::to_sequence(new_nbhs);
     return new_neighbors_seq;
   }
 
+  // Reserves part of the degree bound of p for each of its labels, as the
+  // per-label graphs of Stitched-Vamana do: for each label, up to
+  // R / (2 * labels of p) of the candidates with that label are kept by
+  // the alpha prune among themselves alone, and new_nbhs fills the rest.
+  // Otherwise the neighbors that share a common label would crowd out
+  // those of a rare one, whose subgraph would fall apart.
+  void reserve_labels(indexType p, std::vector<pid> &sorted, PR &Points,
+                      double alpha, std::vector<indexType> &new_nbhs) {
+    auto labels_p = (*labels)[p];
+    if (labels_p.size() == 0) return;
+    size_t quota = std::max<size_t>(1, BP.R / (2 * labels_p.size()));
+    std::vector<indexType> reserved;
+    std::vector<indexType> kept;
+    for (indexType l : labels_p) {
+      kept.clear();
+      for (auto [c, dist] : sorted) {
+        if (kept.size() == quota) break;
+        if (c == p || !labels->has(c, l)) continue;
+        bool pruned = false;
+        for (indexType k : kept)
+          if (alpha * Points[k].distance(Points[c]) <= dist) {
+            pruned = true;
+            break;
+          }
+        if (!pruned) kept.push_back(c);
+      }
+      reserved.insert(reserved.end(), kept.begin(), kept.end());
+    }
+    std::sort(reserved.begin(), reserved.end());
+    reserved.erase(std::unique(reserved.begin(), reserved.end()), reserved.end());
+    size_t m = reserved.size();
+    for (indexType a : new_nbhs) {
+      if (reserved.size() >= BP.R) break;
+      if (!std::binary_search(reserved.begin(), reserved.begin() + m, a))
+        reserved.push_back(a);
+    }
+    new_nbhs = reserved;
+  }
+
+  parlay::sequence<indexType> robustPrune(indexType p,
+                                          parlay::sequence<pid> &cand,
+                                          GraphI &G, PR &Points, double alpha,
+                                          bool add = true) {
+    return robustPrune(p, parlay::make_slice(cand), G, Points, alpha, add);
+  }
+
   // wrapper to allow calling robustPrune on a sequence of candidates
   // that do not come with precomputed distances
   parlay::sequence<indexType> robustPrune(
@@ -116,16 +199,54 @@ struct knn_index {
       PR &Points, double alpha, bool add = true) {
     parlay::sequence<pid> cc;
     cc.reserve(candidates.size());  // + size_of(p->out_nbh));
+    std::vector<distanceType> dists(candidates.size());
+    Points.distance_batch(Points[p], candidates.begin(), candidates.size(),
+                          dists.data());
     for (size_t i = 0; i < candidates.size(); ++i) {
-      cc.push_back(std::make_pair(candidates[i],
-                                  Points[candidates[i]].distance(Points[p])));
+      cc.push_back(std::make_pair(candidates[i], dists[i]));
     }
     return robustPrune(p, cc, G, Points, alpha, add);
   }
 
+  // The new out neighbors of p in a graph built for filters, as in
+  // Filtered-DiskANN: for each of p's labels, p is searched for through
+  // the points with that label only (see filtered_beam_search), starting
+  // from the label's start point, and the points found are pruned with the
+  // filtered prune.  Points without labels are inserted as usual.
+  parlay::sequence<indexType> filtered_insert_candidates(
+      indexType p, GraphI &G, PR &Points, QueryParams &QP,
+      beam_search_context<indexType, distanceType> &ctx,
+      stats<indexType> &BuildStats, double alpha) {
+    parlay::sequence<pid> candidates;
+    if ((*labels)[p].size() == 0) {
+      auto visited = beam_search<Point, PointRange, indexType>(
+          Points[p], G, Points, parlay::make_slice(&start_point, &start_point + 1),
+          QP, ctx).first.second;
+      candidates = parlay::to_sequence(visited);
+    }
+    for (indexType l : (*labels)[p]) {
+      indexType start = label_starts[l];
+      auto [pairElts, dist_cmps] = filtered_beam_search(
+          Points[p], G, Points, parlay::make_slice(&start, &start + 1),
+          [&](indexType a) { return labels->has(a, l); }, QP, ctx, true);
+      candidates.append(pairElts.first);
+    }
+    candidates = parlay::remove_duplicates_ordered(
+        candidates, [](pid a, pid b) { return a.first < b.first; });
+    BuildStats.increment_visited(p, candidates.size());
+    return robustPrune(p, candidates, G, Points, alpha);
+  }
+
   void build_index(GraphI &G, PR &Points, stats<indexType> &BuildStats) {
     std::cout << "Building graph..." << std::endl;
-    start_point = 0;
+    start_point = approximate_medoid<PR, indexType>(Points);
+    G.set_start_point(start_point);
+    std::cout << "Start point " << start_point << std::endl;
+    if (labels != nullptr) {
+      label_starts = label_start_points<PR, indexType>(*labels, Points, start_point);
+      std::cout << "Building for filters on " << label_starts.size()
+                << " labels" << std::endl;
+    }
     parlay::sequence<indexType> inserts = parlay::tabulate(
         Points.size(), [&](size_t i) { return static_cast<indexType>(i); });
 
@@ -272,15 +393,22 @@ struct knn_index {
       }
       parlay::sequence<parlay::sequence<indexType>> new_out_(ceiling - floor);
       // search for each node starting from the start_point, then call
-      // robustPrune with the visited list as its candidate set
+      // robustPrune with the visited list as its candidate set (see
+      // filtered_insert_candidates for graphs built for filters)
       t_beam.start();
       parlay::parallel_for(floor, ceiling, [&](size_t i) {
         size_t index = shuffled_inserts[i];
         QueryParams QP((long)0, BP.L, (double)0.0, (long)Points.size(),
                        (long)G.max_degree());
-        parlay::sequence<pid> visited =
-            (beam_search<Point, PointRange, indexType>(Points[index], G, Points,
-                                                       start_point, QP))
+        auto &ctx = local_search_context<indexType, distanceType>();
+        if (labels != nullptr) {
+          new_out_[i - floor] = filtered_insert_candidates(index, G, Points, QP, ctx, BuildStats, alpha);
+          return;
+        }
+        auto visited =
+            (beam_search<Point, PointRange, indexType>(
+                 Points[index], G, Points,
+                 parlay::make_slice(&start_point, &start_point + 1), QP, ctx))
                 .first.second;
         BuildStats.increment_visited(index, visited.size());
         new_out_[i - floor] = robustPrune(index, visited, G, Points, alpha);
@@ -25,6 +25,8 @@
 #include "../utils/NSGDist.h"
 #include "../utils/beamSearch.h"
 #include "../utils/check_nn_recall.h"
+#include "../utils/check_filtered_recall.h"
+#include "../utils/check_range_recall.h"
 #include "../utils/parse_results.h"
 #include "../utils/stats.h"
 #include "../utils/types.h"
@@ -35,14 +37,22 @@
 #include "parlay/random.h"
 
 
-template<typename Point, typename PointRange, typename indexType>
+template<typename Point, typename PointRange, typename indexType,
+         typename QPointRange = PQPointRange<Point>>
 void ANN(Graph<indexType> &G, long k, BuildParams &BP,
          PointRange &Query_Points,
          groundTruth<indexType> GT, char *res_file,
-         bool graph_built, PointRange &Points) {
+         bool graph_built, PointRange &Points,
+         parlay::sequence<indexType> &id_map,
+         QPointRange *QPoints = nullptr,
+         RangeGroundTruth<indexType> *RGT = nullptr, double radius = 0,
+         PointLabels<indexType> *Base_Labels = nullptr,
+         PointLabels<indexType> *Query_Labels = nullptr) {
   parlay::internal::timer t("ANN");
   using findex = knn_index<Point, PointRange, indexType>;
   findex I(BP);
+  // with base labels the graph is built for filtered searches
+  I.labels = Base_Labels;
   double idx_time;
   stats<unsigned int> BuildStats(G.size());
   if(graph_built){
@@ -52,17 +62,32 @@ void ANN(Graph<indexType> &G, long k, BuildParams &BP,
     idx_time = t.next_time();
   }
 
-  indexType start_point = I.get_start();
+  // the medoid chosen by build_index, or the one saved with the graph
+  indexType start_point = G.start_point();
   std::string name = "Vamana";
   std::string params =
       "R = " + std::to_string(BP.R) + ", L = " + std::to_string(BP.L);
+  if (Base_Labels != nullptr && !graph_built) params += ", filtered";
+  // searches start from the router's entries if BP asks for a router
+  entry_router<indexType> router;
+  if (BP.num_entries > 0) {
+    router = entry_router<indexType>(Points, BP.num_entries, BP.entry_starts);
+    idx_time += t.next_time();
+    params += ", entries = " + std::to_string(router.size()) +
+              ", starts = " + std::to_string(router.num_starts);
+  }
   auto [avg_deg, max_deg] = graph_stats_(G);
   auto vv = BuildStats.visited_stats();
   std::cout << "Average visited: " << vv[0] << ", Tail visited: " << vv[1]
             << std::endl;
   Graph_ G_(name, params, G.size(), avg_deg, max_deg, idx_time);
   G_.print();
-  if(Query_Points.size() != 0) search_and_parse<Point, PointRange, indexType>(G_, G, Points, Query_Points, GT, res_file, k, false, start_point);
+  if(Query_Points.size() != 0 && Query_Labels != nullptr)
+    filtered_search_and_parse<Point, PointRange, indexType>(G_, G, Points, Query_Points, GT, *Base_Labels, *Query_Labels, res_file, k, start_point, id_map);
+  else if(Query_Points.size() != 0 && RGT != nullptr)
+    range_search_and_parse<Point, PointRange, indexType>(G_, G, Points, Query_Points, *RGT, radius, res_file, id_map);
+  else if(Query_Points.size() != 0) search_and_parse<Point, PointRange, indexType>(G_, G, Points, Query_Points, GT, res_file, k, false, start_point, id_map, QPoints,
+                                                                                 BP.num_entries > 0 ? &router : nullptr, BP.interleave);
 }
 
 
@@ -7,26 +7,39 @@
 // #include "utils/types.h"
 #include "utils/euclidian_point.h"
 #include "utils/mips_point.h"
+#include "utils/hamming_point.h"
+#include "utils/cosine_point.h"
+#include "utils/labels.h"
 #include "utils/point_range.h"
 
 using pid = std::pair<int, float>;
 
 template <typename PointRange>
-parlay::sequence<parlay::sequence<pid>> compute_groundtruth(PointRange &B,
-                                                            PointRange &Q,
-                                                            int k) {
+parlay::sequence<parlay::sequence<pid>> compute_groundtruth(
+    PointRange &B, PointRange &Q, int k,
+    PointLabels<unsigned int> *BL = nullptr,
+    PointLabels<unsigned int> *QL = nullptr) {
   /**
    * Input: B (base), Q (query), and k (number of nearest neighbors to compute)
    * Returns: nested sequence of pairs (pid) of size k for each query point
+   * With labels BL and QL, only the base points with all of a query's labels
+   * are its neighbors, and queries with fewer than k are padded with -1.
    */
   unsigned d = B.dimension();
   size_t q = Q.size();
   size_t b = B.size();
+  if (QL != nullptr && (BL->size() != b || QL->size() != q)) {
+    std::cout << "Error: " << BL->size() << " base and " << QL->size()
+              << " query labels for " << b << " base and " << q
+              << " query points" << std::endl;
+    abort();
+  }
   auto answers = parlay::tabulate(q, [&](size_t i) {
     float topdist = B[0].d_min();
     int toppos;
     parlay::sequence<pid> topk;
     for (size_t j = 0; j < b; j++) {
+      if (QL != nullptr && !BL->matches(j, (*QL)[i])) continue;
       // float dist = D->distance((Q[i].coordinates).begin(),
       // (B[j].coordinates).begin(), d);
       float dist = Q[i].distance(B[j]);
@@ -50,6 +63,8 @@ parlay::sequence<parlay::sequence<pid>> compute_groundtruth(PointRange &B,
         toppos = new_toppos;
       }
     }
+    while (topk.size() < k)
+      topk.push_back(std::make_pair(-1, std::numeric_limits<float>::max()));
     return topk;
   });
   std::cout << "Done computing groundtruth" << std::endl;
@@ -122,7 +137,8 @@ int main(int argc, char *argv[]) {
   commandLine P(argc, argv,
                 "[-base_path <b>] [-query_path <q>] [-data_type <d>] [-k <k> ] "
                 "[-dist_func <d>] [-gt_path <outfile>] [-with_rm <with_rm>] "
-                "[-interval_sz <interval_sz>]");
+                "[-interval_sz <interval_sz>] [-base_labels <bl>] "
+                "[-query_labels <ql>]");
 
   char *gFile = P.getOptionValue("-gt_path");
   char *qFile = P.getOptionValue("-query_path");
@@ -135,9 +151,25 @@ int main(int argc, char *argv[]) {
   bool withRemoval = P.getOptionIntValue("-with_rm", 0) > 0;
   int intervalSize = P.getOptionIntValue("-interval_sz", 1);
 
+  // for filtered searches, see labels.h
+  char *blFile = P.getOptionValue("-base_labels");
+  char *qlFile = P.getOptionValue("-query_labels");
+  if ((blFile == NULL) != (qlFile == NULL) || (qlFile != NULL && withRemoval)) {
+    std::cout << "Error: filters need both -base_labels and -query_labels, "
+                 "and no -with_rm"
+              << std::endl;
+    abort();
+  }
+  PointLabels<unsigned int> base_labels(blFile);
+  PointLabels<unsigned int> query_labels(qlFile);
+  PointLabels<unsigned int> *BL = blFile == NULL ? nullptr : &base_labels;
+  PointLabels<unsigned int> *QL = qlFile == NULL ? nullptr : &query_labels;
+
   std::string df = std::string(dfc);
-  if (df != "Euclidian" && df != "mips") {
-    std::cout << "Error: invalid distance type: specify Euclidian or mips"
+  if (df != "Euclidian" && df != "mips" && df != "cosine" &&
+      df != "hamming") {
+    std::cout << "Error: invalid distance type: specify Euclidian, mips, "
+                 "cosine or hamming"
               << std::endl;
     abort();
   }
@@ -150,6 +182,17 @@ int main(int argc, char *argv[]) {
     abort();
   }
 
+  if (df == "cosine" && tp != "float") {
+    std::cout << "Error: cosine distance is for float points" << std::endl;
+    abort();
+  }
+
+  if (df == "hamming" && tp != "uint8") {
+    std::cout << "Error: hamming distance is for uint8 points of packed bits"
+              << std::endl;
+    abort();
+  }
+
   std::cout << "Computing the " << k << " nearest neighbors" << std::endl;
 
   int maxDeg = 0;
@@ -179,6 +222,14 @@ int main(int argc, char *argv[]) {
         answers = compute_groundtruth_with_removal<
             PointRange<float, Mips_Point<float>>>(B, Q, intervalSize, k);
         n = B.size();
+      } else if (df == "cosine") {
+        PointRange<float, Cosine_Point<float>> B =
+            PointRange<float, Cosine_Point<float>>(bFile);
+        PointRange<float, Cosine_Point<float>> Q =
+            PointRange<float, Cosine_Point<float>>(qFile);
+        answers = compute_groundtruth_with_removal<
+            PointRange<float, Cosine_Point<float>>>(B, Q, intervalSize, k);
+        n = B.size();
       }
     } else if (tp == "uint8") {
       std::cout << "Detected uint8 coordinates" << std::endl;
@@ -199,6 +250,14 @@ int main(int argc, char *argv[]) {
         answers = compute_groundtruth_with_removal<
             PointRange<uint8_t, Mips_Point<uint8_t>>>(B, Q, intervalSize, k);
         n = B.size();
+      } else if (df == "hamming") {
+        PointRange<uint8_t, Hamming_Point> B =
+            PointRange<uint8_t, Hamming_Point>(bFile);
+        PointRange<uint8_t, Hamming_Point> Q =
+            PointRange<uint8_t, Hamming_Point>(qFile);
+        answers = compute_groundtruth_with_removal<
+            PointRange<uint8_t, Hamming_Point>>(B, Q, intervalSize, k);
+        n = B.size();
       }
     } else if (tp == "int8") {
       std::cout << "Detected int8 coordinates" << std::endl;
@@ -237,14 +296,21 @@ int main(int argc, char *argv[]) {
             PointRange<float, Euclidian_Point<float>>(qFile);
         answers =
             compute_groundtruth<PointRange<float, Euclidian_Point<float>>>(B, Q,
-                                                                           k);
+                                                                           k, BL, QL);
       } else if (df == "mips") {
         PointRange<float, Mips_Point<float>> B =
             PointRange<float, Mips_Point<float>>(bFile);
         PointRange<float, Mips_Point<float>> Q =
             PointRange<float, Mips_Point<float>>(qFile);
         answers =
-            compute_groundtruth<PointRange<float, Mips_Point<float>>>(B, Q, k);
+            compute_groundtruth<PointRange<float, Mips_Point<float>>>(B, Q, k, BL, QL);
+      } else if (df == "cosine") {
+        PointRange<float, Cosine_Point<float>> B =
+            PointRange<float, Cosine_Point<float>>(bFile);
+        PointRange<float, Cosine_Point<float>> Q =
+            PointRange<float, Cosine_Point<float>>(qFile);
+        answers = compute_groundtruth<PointRange<float, Cosine_Point<float>>>(
+            B, Q, k, BL, QL);
       }
     } else if (tp == "uint8") {
       std::cout << "Detected uint8 coordinates" << std::endl;
@@ -255,14 +321,21 @@ int main(int argc, char *argv[]) {
             PointRange<uint8_t, Euclidian_Point<uint8_t>>(qFile);
         answers =
             compute_groundtruth<PointRange<uint8_t, Euclidian_Point<uint8_t>>>(
-                B, Q, k);
+                B, Q, k, BL, QL);
       } else if (df == "mips") {
         PointRange<uint8_t, Mips_Point<uint8_t>> B =
             PointRange<uint8_t, Mips_Point<uint8_t>>(bFile);
         PointRange<uint8_t, Mips_Point<uint8_t>> Q =
             PointRange<uint8_t, Mips_Point<uint8_t>>(qFile);
         answers = compute_groundtruth<PointRange<uint8_t, Mips_Point<uint8_t>>>(
-            B, Q, k);
+            B, Q, k, BL, QL);
+      } else if (df == "hamming") {
+        PointRange<uint8_t, Hamming_Point> B =
+            PointRange<uint8_t, Hamming_Point>(bFile);
+        PointRange<uint8_t, Hamming_Point> Q =
+            PointRange<uint8_t, Hamming_Point>(qFile);
+        answers =
+            compute_groundtruth<PointRange<uint8_t, Hamming_Point>>(B, Q, k, BL, QL);
       }
     } else if (tp == "int8") {
       std::cout << "Detected int8 coordinates" << std::endl;
@@ -273,14 +346,14 @@ int main(int argc, char *argv[]) {
             PointRange<int8_t, Euclidian_Point<int8_t>>(qFile);
         answers =
             compute_groundtruth<PointRange<int8_t, Euclidian_Point<int8_t>>>(
-                B, Q, k);
+                B, Q, k, BL, QL);
       } else if (df == "mips") {
         PointRange<int8_t, Mips_Point<int8_t>> B =
             PointRange<int8_t, Mips_Point<int8_t>>(bFile);
         PointRange<int8_t, Mips_Point<int8_t>> Q =
             PointRange<int8_t, Mips_Point<int8_t>>(qFile);
         answers = compute_groundtruth<PointRange<int8_t, Mips_Point<int8_t>>>(
-            B, Q, k);
+            B, Q, k, BL, QL);
       }
     }
     write_ibin(answers, std::string(gFile), k);
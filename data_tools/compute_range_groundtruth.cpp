@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "parlay/io.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "utils/euclidian_point.h"
+#include "utils/mips_point.h"
+#include "utils/hamming_point.h"
+#include "utils/cosine_point.h"
+#include "utils/point_range.h"
+
+// Brute force ground truth for range searches: every base point within
+// distance radius of each query, closest first, written in the range
+// format read by RangeGroundTruth (see types.h).  The queries are
+// processed in parallel, each comparing with the base points a block at a
+// time with the batched distance kernels.
+template <typename PointRange>
+void compute_range_groundtruth(char* bFile, char* qFile, double radius,
+                               char* gFile) {
+  PointRange B(bFile);
+  PointRange Q(qFile);
+  size_t n = B.size();
+  size_t block = 1024;
+  auto ids = parlay::tabulate(n, [](size_t j) { return (unsigned int)j; });
+  auto matches = parlay::tabulate(Q.size(), [&](size_t i) {
+    std::vector<std::pair<float, unsigned int>> found;
+    std::vector<float> dists(block);
+    for (size_t j = 0; j < n; j += block) {
+      size_t m = std::min(block, n - j);
+      B.distance_batch(Q[i], ids.begin() + j, m, dists.data());
+      for (size_t l = 0; l < m; l++)
+        if (dists[l] <= radius) found.push_back({dists[l], (unsigned int)(j + l)});
+    }
+    std::sort(found.begin(), found.end());
+    return parlay::to_sequence(found);
+  });
+
+  auto sizes = parlay::map(matches, [](auto& m) { return (unsigned int)m.size(); });
+  auto flat = parlay::flatten(matches);
+  size_t total = flat.size();
+  size_t nonzero = parlay::count_if(sizes, [](unsigned int s) { return s > 0; });
+  std::cout << "Found " << total << " points within radius " << radius
+            << ", " << nonzero << " of " << Q.size() << " queries have one"
+            << std::endl;
+
+  auto match_ids = parlay::map(flat, [](auto& p) { return p.second; });
+  auto match_dists = parlay::map(flat, [](auto& p) { return p.first; });
+  unsigned int preamble[2] = {(unsigned int)Q.size(), (unsigned int)total};
+  std::ofstream writer;
+  writer.open(gFile, std::ios::binary | std::ios::out);
+  writer.write((char*)preamble, 2 * sizeof(unsigned int));
+  writer.write((char*)sizes.begin(), sizes.size() * sizeof(unsigned int));
+  writer.write((char*)match_ids.begin(), total * sizeof(unsigned int));
+  writer.write((char*)match_dists.begin(), total * sizeof(float));
+  writer.close();
+}
+
+int main(int argc, char* argv[]) {
+  commandLine P(argc, argv,
+                "[-base_path <b>] [-query_path <q>] [-data_type <d>] "
+                "[-dist_func <d>] [-radius <r>] [-gt_path <outfile>]");
+
+  char* gFile = P.getOptionValue("-gt_path");
+  char* qFile = P.getOptionValue("-query_path");
+  char* bFile = P.getOptionValue("-base_path");
+  char* vectype = P.getOptionValue("-data_type");
+  char* dfc = P.getOptionValue("-dist_func");
+  char* rad = P.getOptionValue("-radius");
+  if (gFile == NULL || qFile == NULL || bFile == NULL || vectype == NULL ||
+      dfc == NULL || rad == NULL)
+    P.badArgument();
+  double radius = atof(rad);
+
+  std::string df = std::string(dfc);
+  std::string tp = std::string(vectype);
+  if (df != "Euclidian" && df != "mips" && df != "cosine" &&
+      df != "hamming") {
+    std::cout << "Error: invalid distance type: specify Euclidian, mips, "
+                 "cosine or hamming"
+              << std::endl;
+    abort();
+  }
+  if ((tp != "uint8") && (tp != "int8") && (tp != "float")) {
+    std::cout << "Error: data type not specified correctly, specify int8, "
+                 "uint8, or float"
+              << std::endl;
+    abort();
+  }
+  if (df == "cosine" && tp != "float") {
+    std::cout << "Error: cosine distance is for float points" << std::endl;
+    abort();
+  }
+  if (df == "hamming" && tp != "uint8") {
+    std::cout << "Error: hamming distance is for uint8 points of packed bits"
+              << std::endl;
+    abort();
+  }
+
+  if (tp == "float") {
+    if (df == "Euclidian")
+      compute_range_groundtruth<PointRange<float, Euclidian_Point<float>>>(
+          bFile, qFile, radius, gFile);
+    else if (df == "mips")
+      compute_range_groundtruth<PointRange<float, Mips_Point<float>>>(
+          bFile, qFile, radius, gFile);
+    else if (df == "cosine")
+      compute_range_groundtruth<PointRange<float, Cosine_Point<float>>>(
+          bFile, qFile, radius, gFile);
+  } else if (tp == "uint8") {
+    if (df == "Euclidian")
+      compute_range_groundtruth<PointRange<uint8_t, Euclidian_Point<uint8_t>>>(
+          bFile, qFile, radius, gFile);
+    else if (df == "mips")
+      compute_range_groundtruth<PointRange<uint8_t, Mips_Point<uint8_t>>>(
+          bFile, qFile, radius, gFile);
+    else if (df == "hamming")
+      compute_range_groundtruth<PointRange<uint8_t, Hamming_Point>>(
+          bFile, qFile, radius, gFile);
+  } else if (tp == "int8") {
+    if (df == "Euclidian")
+      compute_range_groundtruth<PointRange<int8_t, Euclidian_Point<int8_t>>>(
+          bFile, qFile, radius, gFile);
+    else if (df == "mips")
+      compute_range_groundtruth<PointRange<int8_t, Mips_Point<int8_t>>>(
+          bFile, qFile, radius, gFile);
+  }
+  return 0;
+}
@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "parlay/internal/get_time.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "utils/euclidian_point.h"
+#include "utils/mips_point.h"
+#include "utils/hamming_point.h"
+#include "utils/sq_kernels.h"
+
+// Single threaded throughput of the distance kernels on random vectors.
+// Each kernel compares one query with every row of an n x d table, in a
+// random order, first one pair at a time and then in batches the size of
+// a graph neighborhood.  Keep n * d small enough to fit in cache to
+// measure the arithmetic rather than the memory system.  Run with
+// PARLAYANN_ISA=scalar, sse2, avx2, avx512 or avx512_vnni to compare the
+// instruction set levels.  With -check it instead checks the kernels of
+// every level the CPU supports against the scalar ones, see check_kernels.
+
+template <typename T>
+void random_rows(std::vector<T>& v, std::mt19937& gen) {
+  if constexpr (!std::is_integral<T>::value) {
+    std::uniform_real_distribution<float> dist(-1.0, 1.0);
+    for (auto& x : v) x = dist(gen);
+  } else {
+    std::uniform_int_distribution<int> dist(std::numeric_limits<T>::min(),
+                                            std::numeric_limits<T>::max());
+    for (auto& x : v) x = (T)dist(gen);
+  }
+}
+
+void report(std::string name, size_t count, size_t bytes, double time,
+            double checksum) {
+  std::cout << name << ": " << count / time / 1e6 << " M distances/s, "
+            << bytes / time / 1e9 << " GB/s (checksum " << checksum << ")"
+            << std::endl;
+}
+
+// with D > 0, the kernels specialized for dimension D = d
+template <typename T, unsigned D = 0>
+void bench_type(std::string tp, size_t n, unsigned d, size_t batch,
+                int rounds) {
+  if (D) tp += " d=" + std::to_string(D);
+  unsigned stride = 64 * ((d * sizeof(T) + 63) / 64) / sizeof(T);
+  std::mt19937 gen(n * d);
+  std::vector<T> rows(n * stride);
+  std::vector<T> q(stride);
+  random_rows(rows, gen);
+  random_rows(q, gen);
+  std::vector<unsigned> ids(n);
+  for (size_t i = 0; i < n; i++) ids[i] = i;
+  std::shuffle(ids.begin(), ids.end(), gen);
+  std::vector<float> out(batch);
+
+  size_t count = n * rounds;
+  size_t bytes = count * d * sizeof(T);
+  for (std::string df : {"Euclidian", "mips"}) {
+    bool l2 = (df == "Euclidian");
+    double checksum = 0;
+    parlay::internal::timer t("distance", false);
+    t.start();
+    for (int r = 0; r < rounds; r++)
+      for (size_t i = 0; i < n; i++) {
+        const T* row = rows.data() + (size_t)ids[i] * stride;
+        checksum += l2 ? euclidian_distance<D>(q.data(), row, d)
+                       : mips_distance<D>(q.data(), row, d);
+      }
+    report(tp + " " + df + " pair", count, bytes, t.next_time(), checksum);
+
+    checksum = 0;
+    t.start();
+    for (int r = 0; r < rounds; r++)
+      for (size_t i = 0; i < n; i += batch) {
+        size_t m = std::min(batch, n - i);
+        if (l2)
+          euclidian_distance_batch<D>(q.data(), rows.data(), stride,
+                                      ids.data() + i, m, d, out.data());
+        else
+          mips_distance_batch<D>(q.data(), rows.data(), stride,
+                                 ids.data() + i, m, d, out.data());
+        for (size_t j = 0; j < m; j++) checksum += out[j];
+      }
+    report(tp + " " + df + " batch", count, bytes, t.next_time(), checksum);
+  }
+
+  // bounded by the distance to the closest eighth of the rows, as if the
+  // rest were past the worst distance on a full beam.  The distances
+  // between random rows are concentrated, so few stop much before the end.
+  std::vector<float> all(n);
+  euclidian_distance_batch<D>(q.data(), rows.data(), stride, ids.data(), n, d,
+                              all.data());
+  std::nth_element(all.begin(), all.begin() + n / 8, all.end());
+  std::vector<float> bounds(batch, all[n / 8]);
+  double checksum = 0;
+  parlay::internal::timer t("distance", false);
+  t.start();
+  for (int r = 0; r < rounds; r++)
+    for (size_t i = 0; i < n; i += batch) {
+      size_t m = std::min(batch, n - i);
+      euclidian_distance_batch_bounded<D>(q.data(), rows.data(), stride,
+                                          ids.data() + i, m, d,
+                                          bounds.data(), out.data());
+      for (size_t j = 0; j < m; j++) checksum += std::min(out[j], bounds[j]);
+    }
+  report(tp + " Euclidian bounded batch", count, bytes, t.next_time(),
+         checksum);
+}
+
+// the generic kernels, and those specialized for d if it is one of the
+// dimensions neighborsTime specializes
+template <typename T>
+void bench_dims(std::string tp, size_t n, unsigned d, size_t batch,
+                int rounds) {
+  bench_type<T>(tp, n, d, batch, rounds);
+  switch (d) {
+    case 96: bench_type<T, 96>(tp, n, d, batch, rounds); break;
+    case 100: bench_type<T, 100>(tp, n, d, batch, rounds); break;
+    case 128: bench_type<T, 128>(tp, n, d, batch, rounds); break;
+    case 256: bench_type<T, 256>(tp, n, d, batch, rounds); break;
+    case 768: bench_type<T, 768>(tp, n, d, batch, rounds); break;
+  }
+}
+
+// the scalar quantized kernels, between codes and from a float query
+template <int Bits>
+void bench_sq(std::string tp, size_t n, unsigned d, int rounds) {
+  unsigned pd = ((d + 512 / Bits - 1) / (512 / Bits)) * (512 / Bits);
+  size_t row = pd * Bits / 8;
+  std::mt19937 gen(n * d);
+  std::vector<uint8_t> rows(n * row);
+  std::vector<float> w(pd), z(pd), u(pd);
+  random_rows(rows, gen);
+  random_rows(w, gen);
+  random_rows(z, gen);
+  random_rows(u, gen);
+  for (auto& x : w) x = std::abs(x);
+  std::vector<unsigned> ids(n);
+  for (size_t i = 0; i < n; i++) ids[i] = i;
+  std::shuffle(ids.begin(), ids.end(), gen);
+
+  const sq_kernel_table& K = sq_kernels<Bits>();
+  size_t count = n * rounds;
+  size_t bytes = count * row;
+  for (std::string kernel : {"l2_codes", "dot_codes", "l2_float", "dot_float"}) {
+    double checksum = 0;
+    parlay::internal::timer t("distance", false);
+    t.start();
+    for (int r = 0; r < rounds; r++)
+      for (size_t i = 0; i < n; i++) {
+        const uint8_t* c = rows.data() + (size_t)ids[i] * row;
+        if (kernel == "l2_codes")
+          checksum += K.l2_codes(w.data(), rows.data(), c, pd);
+        else if (kernel == "dot_codes")
+          checksum += K.dot_codes(w.data(), z.data(), rows.data(), c, pd);
+        else if (kernel == "l2_float")
+          checksum += K.l2_float(w.data(), u.data(), c, pd);
+        else
+          checksum += K.dot_float(u.data(), c, pd);
+      }
+    report(tp + " " + kernel, count, bytes, t.next_time(), checksum);
+  }
+}
+
+// Hamming distances between rows of d bytes of packed bits
+void bench_hamming(size_t n, unsigned d, size_t batch, int rounds) {
+  unsigned stride = 64 * ((d + 63) / 64);
+  std::mt19937 gen(n * d);
+  std::vector<uint8_t> rows(n * stride);
+  std::vector<uint8_t> q(stride);
+  random_rows(rows, gen);
+  random_rows(q, gen);
+  std::vector<unsigned> ids(n);
+  for (size_t i = 0; i < n; i++) ids[i] = i;
+  std::shuffle(ids.begin(), ids.end(), gen);
+  std::vector<float> out(batch);
+
+  size_t count = n * rounds;
+  size_t bytes = count * d;
+  double checksum = 0;
+  parlay::internal::timer t("distance", false);
+  t.start();
+  for (int r = 0; r < rounds; r++)
+    for (size_t i = 0; i < n; i++)
+      checksum +=
+          hamming_distance(q.data(), rows.data() + (size_t)ids[i] * stride, d);
+  report("hamming pair", count, bytes, t.next_time(), checksum);
+
+  Hamming_Point p(q.data(), d, stride, -1);
+  checksum = 0;
+  t.start();
+  for (int r = 0; r < rounds; r++)
+    for (size_t i = 0; i < n; i += batch) {
+      size_t m = std::min(batch, n - i);
+      p.distance_batch(rows.data(), stride, ids.data() + i, m, out.data());
+      for (size_t j = 0; j < m; j++) checksum += out[j];
+    }
+  report("hamming batch", count, bytes, t.next_time(), checksum);
+}
+
+// Counts the checks of check_kernels and prints the first failures.
+struct kernel_checker {
+  size_t checks = 0;
+  size_t failures = 0;
+
+  void expect(bool ok, const std::string& what) {
+    checks++;
+    if (ok) return;
+    if (failures++ < 20) std::cout << "FAILED " << what << std::endl;
+  }
+
+  // byte distances must be equal; float distances may differ by the
+  // rounding of a sum of d terms in another order, relative to mag, the
+  // sum of the magnitudes of the terms
+  template <typename T>
+  void expect_close(double got, double want, double mag, unsigned d,
+                    const std::string& what) {
+    double tol = std::is_integral<T>::value ? 0 : d * FLT_EPSILON * mag;
+    expect(std::abs(got - want) <= tol, what + ": got " + std::to_string(got) +
+                                            ", expected " +
+                                            std::to_string(want));
+  }
+};
+
+template <typename T>
+double magnitude(bool l2, const T* p, const T* q, unsigned d) {
+  double m = 0;
+  for (unsigned i = 0; i < d; i++) {
+    double a = (float)p[i], b = (float)q[i];
+    m += l2 ? (a - b) * (a - b) : std::abs(a * b);
+  }
+  return m;
+}
+
+// a query and four rows of d entries, each followed by at least a cache
+// line of noise, so that a kernel that reads past d gives a wrong distance
+template <typename T>
+struct check_rows {
+  unsigned stride;
+  std::vector<T> v;
+  const T* r[4];
+
+  check_rows(unsigned d, std::mt19937& gen)
+      : stride(64 * ((d * sizeof(T) + 63) / 64 + 1) / sizeof(T)),
+        v(5 * stride) {
+    random_rows(v, gen);
+    for (int l = 0; l < 4; l++) r[l] = q() + (l + 1) * stride;
+  }
+  const T* q() const { return v.data(); }
+};
+
+// the pair and four row kernels of one level against the scalar pair
+// kernel, for Euclidian distances and dot products
+template <typename T, typename Pair>
+void check_level(kernel_checker& C, const std::string& name, unsigned d,
+                 std::mt19937& gen, Pair ref_l2, Pair l2, Pair ref_dot,
+                 Pair dot, rows4_kernel<T> l2_rows4,
+                 rows4_kernel<T> dot_rows4) {
+  check_rows<T> R(d, gen);
+  for (bool is_l2 : {true, false}) {
+    std::string what = name + (is_l2 ? " l2" : " dot");
+    float out[4];
+    (is_l2 ? l2_rows4 : dot_rows4)(R.q(), R.r, d, out);
+    for (int l = 0; l < 4; l++) {
+      double want = (is_l2 ? ref_l2 : ref_dot)(R.q(), R.r[l], d);
+      double mag = magnitude(is_l2, R.q(), R.r[l], d);
+      C.expect_close<T>((is_l2 ? l2 : dot)(R.q(), R.r[l], d), want, mag, d,
+                        what + " pair");
+      // rows4 returns floats, so byte distances past 2^24 are rounded
+      C.expect_close<T>(out[l], (float)want, mag, d, what + " rows4");
+    }
+  }
+}
+
+// The bounded kernel of a level against its unbounded one, with bounds
+// below, at and above each distance: a result at most its bound must be
+// the unbounded distance bit for bit, a result above it must come with an
+// unbounded distance above it, and a partial sum is never above the
+// distance.
+template <typename T>
+void check_bounded(kernel_checker& C, const std::string& name, unsigned d,
+                   std::mt19937& gen, rows4_kernel<T> rows4,
+                   rows4_bounded_kernel<T> bounded) {
+  check_rows<T> R(d, gen);
+  float full[4];
+  rows4(R.q(), R.r, d, full);
+  const float factors[] = {0, 0.5, 0.9, 0.99, 1, 1.01, 2, INFINITY};
+  for (int t = 0; t < 8; t++) {
+    float bounds[4], out[4];
+    for (int l = 0; l < 4; l++) bounds[l] = full[l] * factors[(t + l) % 8];
+    bounded(R.q(), R.r, d, bounds, out);
+    for (int l = 0; l < 4; l++) {
+      std::string what = name + " l2 bounded, bound " +
+                         std::to_string(bounds[l]) + ", got " +
+                         std::to_string(out[l]) + ", distance " +
+                         std::to_string(full[l]);
+      C.expect((out[l] <= bounds[l]) == (full[l] <= bounds[l]), what);
+      if (out[l] <= bounds[l])
+        C.expect(out[l] == full[l], what + " (not exact)");
+      C.expect(out[l] <= full[l], what + " (partial sum too large)");
+    }
+  }
+}
+
+// every kernel of every level the CPU supports, for dimension D or, with
+// D = 0, for each of dims
+template <unsigned D>
+void check_tables(kernel_checker& C, std::vector<unsigned> dims) {
+  std::mt19937 gen(D + 1);
+  distance_kernel_table S = distance_kernels_for<D>(ISA_SCALAR);
+  for (int i = ISA_SCALAR; i <= detect_isa(); i++) {
+    distance_kernel_table L = distance_kernels_for<D>((DistanceISA)i);
+    for (unsigned d : dims) {
+      std::string suffix = std::string(" ") + isa_name(L.isa) +
+                           " d=" + std::to_string(d) +
+                           (D ? " (specialized)" : "");
+      check_level<float>(C, "float" + suffix, d, gen, S.float_l2, L.float_l2,
+                         S.float_dot, L.float_dot, L.float_l2_rows4,
+                         L.float_dot_rows4);
+      check_level<uint8_t>(C, "uint8" + suffix, d, gen, S.uint8_l2,
+                           L.uint8_l2, S.uint8_dot, L.uint8_dot,
+                           L.uint8_l2_rows4, L.uint8_dot_rows4);
+      check_level<int8_t>(C, "int8" + suffix, d, gen, S.int8_l2, L.int8_l2,
+                          S.int8_dot, L.int8_dot, L.int8_l2_rows4,
+                          L.int8_dot_rows4);
+      check_level<float16>(C, "fp16" + suffix, d, gen, S.float16_l2,
+                           L.float16_l2, S.float16_dot, L.float16_dot,
+                           L.float16_l2_rows4, L.float16_dot_rows4);
+      check_level<bfloat16>(C, "bf16" + suffix, d, gen, S.bfloat16_l2,
+                            L.bfloat16_l2, S.bfloat16_dot, L.bfloat16_dot,
+                            L.bfloat16_l2_rows4, L.bfloat16_dot_rows4);
+      check_bounded<float>(C, "float" + suffix, d, gen, L.float_l2_rows4,
+                           L.float_l2_rows4_bounded);
+      check_bounded<float16>(C, "fp16" + suffix, d, gen, L.float16_l2_rows4,
+                             L.float16_l2_rows4_bounded);
+      check_bounded<bfloat16>(C, "bf16" + suffix, d, gen,
+                              L.bfloat16_l2_rows4, L.bfloat16_l2_rows4_bounded);
+      // d bytes of packed bits
+      check_rows<uint8_t> R(d, gen);
+      for (int l = 0; l < 4; l++)
+        C.expect(L.hamming(R.q(), R.r[l], d) == S.hamming(R.q(), R.r[l], d),
+                 "hamming" + suffix);
+    }
+  }
+}
+
+// Checks the kernels of every instruction set level the CPU supports
+// against the scalar kernels, at odd and even dimensions around the vector
+// widths and the bounded block, and for each dimension the kernels are
+// specialized for.  Returns true if all of them agree.
+bool check_kernels() {
+  kernel_checker C;
+  std::vector<unsigned> dims = {1,   2,   3,   5,   7,   8,   15,  16,
+                                17,  31,  32,  33,  63,  64,  65,  96,
+                                100, 127, 128, 129, 200, 255, 256, 257,
+                                301, 384, 511, 768, 1023, 1024};
+  check_tables<0>(C, dims);
+  check_tables<96>(C, {96});
+  check_tables<100>(C, {100});
+  check_tables<128>(C, {128});
+  check_tables<256>(C, {256});
+  check_tables<768>(C, {768});
+  std::cout << "Checked the kernels of levels scalar to "
+            << isa_name(detect_isa()) << ": " << C.checks << " checks, "
+            << C.failures << " failed" << std::endl;
+  return C.failures == 0;
+}
+
+int main(int argc, char* argv[]) {
+  commandLine P(argc, argv,
+                "[-data_type <d>] [-dims <d>] [-n <rows>] [-batch <b>] "
+                "[-rounds <r>] [-check]");
+  if (P.getOption("-check")) return check_kernels() ? 0 : 1;
+
+  char* vectype = P.getOptionValue("-data_type");
+  unsigned d = P.getOptionIntValue("-dims", 128);
+  size_t n = P.getOptionLongValue("-n", 10000);
+  size_t batch = P.getOptionIntValue("-batch", 64);
+  int rounds = P.getOptionIntValue("-rounds", 100);
+
+  std::string tp = vectype == nullptr ? "all" : std::string(vectype);
+  if ((tp != "uint8") && (tp != "int8") && (tp != "float") && (tp != "fp16") &&
+      (tp != "bf16") && (tp != "sq8") && (tp != "sq4") && (tp != "hamming") &&
+      (tp != "all")) {
+    std::cout << "Error: data type not specified correctly, specify int8, "
+                 "uint8, float, fp16, bf16, sq8, sq4 or hamming"
+              << std::endl;
+    abort();
+  }
+
+  std::cout << "Distance kernels for " << isa_name(distance_kernels().isa)
+            << ", " << n << " rows of dimension " << d << ", batches of "
+            << batch << std::endl;
+  if (tp == "float" || tp == "all") bench_dims<float>("float", n, d, batch, rounds);
+  if (tp == "fp16" || tp == "all") bench_dims<float16>("fp16", n, d, batch, rounds);
+  if (tp == "bf16" || tp == "all") bench_dims<bfloat16>("bf16", n, d, batch, rounds);
+  if (tp == "uint8" || tp == "all") bench_dims<uint8_t>("uint8", n, d, batch, rounds);
+  if (tp == "int8" || tp == "all") bench_dims<int8_t>("int8", n, d, batch, rounds);
+  if (tp == "sq8" || tp == "all") bench_sq<8>("sq8", n, d, rounds);
+  if (tp == "sq4" || tp == "all") bench_sq<4>("sq4", n, d, rounds);
+  if (tp == "hamming" || tp == "all") bench_hamming(n, d, batch, rounds);
+  return 0;
+}
@@ -0,0 +1,33 @@
+#include <iostream>
+#include <string>
+
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "utils/graph.h"
+
+// Converts a graph between the compact format written by Graph::save and
+// the padded format written by Graph::save_padded, which is mapped
+// directly when loaded.  The input format is detected from the file.
+int main(int argc, char* argv[]) {
+  commandLine P(argc, argv,
+                "[-graph_path <g>] [-graph_outfile <o>] [-format <f>]");
+
+  char* gFile = P.getOptionValue("-graph_path");
+  char* oFile = P.getOptionValue("-graph_outfile");
+  char* fmt = P.getOptionValue("-format");
+  if (gFile == NULL || oFile == NULL) P.badArgument();
+
+  std::string format = fmt == NULL ? "padded" : std::string(fmt);
+  if (format != "padded" && format != "compact") {
+    std::cout << "Error: invalid graph format: specify padded or compact"
+              << std::endl;
+    abort();
+  }
+
+  Graph<unsigned int> G(gFile);
+  if (format == "padded")
+    G.save_padded(oFile);
+  else
+    G.save(oFile);
+  return 0;
+}
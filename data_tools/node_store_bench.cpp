@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "parlay/internal/get_time.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "utils/beamSearch.h"
+#include "utils/euclidian_point.h"
+#include "utils/graph.h"
+#include "utils/mips_point.h"
+#include "utils/node_store.h"
+#include "utils/point_range.h"
+
+// Query throughput of a built graph searched from vertex 0 with beam width
+// -L, with the vectors and adjacency lists in separate arrays and then in a
+// node store (see algorithms/utils/node_store.h).  The two layouts run the
+// same search, so their results should be identical.  Each layout is
+// searched -rounds times and the best throughput is kept.
+
+template <typename Point, typename GraphType, typename BaseRange,
+          typename QueryRange>
+parlay::sequence<parlay::sequence<unsigned int>> search(
+    GraphType& G, BaseRange& Points, QueryRange& Query_Points,
+    QueryParams& QP, int rounds, double& QPS, double& cmps) {
+  parlay::sequence<parlay::sequence<unsigned int>> results(
+      Query_Points.size());
+  parlay::sequence<size_t> dist_cmps(Query_Points.size());
+  QPS = 0;
+  for (int r = 0; r < rounds; r++) {
+    parlay::internal::timer t("search", false);
+    t.start();
+    parlay::parallel_for(0, Query_Points.size(), [&](size_t i) {
+      auto& ctx =
+          local_search_context<unsigned int, typename Point::distanceType>();
+      unsigned int start = 0;
+      auto [pairElts, c] = beam_search<Point, BaseRange, unsigned int>(
+          Query_Points[i], G, Points, parlay::make_slice(&start, &start + 1),
+          QP, ctx);
+      auto frontier = pairElts.first;
+      results[i] = parlay::tabulate(
+          std::min<size_t>(QP.k, frontier.size()),
+          [&](size_t j) { return frontier[j].first; });
+      dist_cmps[i] = c;
+    });
+    QPS = std::max(QPS, Query_Points.size() / t.next_time());
+  }
+  cmps = (double)parlay::reduce(dist_cmps) / Query_Points.size();
+  return results;
+}
+
+template <typename Point, typename T>
+void bench(char* gFile, char* bFile, char* qFile, char* cFile, long k, long L,
+           int rounds) {
+  using PR = PointRange<T, Point>;
+  Graph<unsigned int> G(gFile);
+  PR Points(bFile);
+  PR Query_Points(qFile);
+  groundTruth<unsigned int> GT(cFile);
+  QueryParams QP(k, L, 1.35, (long)G.size(), G.max_degree());
+
+  auto recall = [&](parlay::sequence<parlay::sequence<unsigned int>>& R) {
+    size_t correct = 0;
+    for (size_t i = 0; i < R.size(); i++) {
+      std::set<unsigned int> reported(R[i].begin(), R[i].end());
+      for (long j = 0; j < k; j++) correct += reported.count(GT.coordinates(i, j));
+    }
+    return (double)correct / (k * R.size());
+  };
+  auto report = [&](std::string name, double QPS, double cmps,
+                    parlay::sequence<parlay::sequence<unsigned int>>& R) {
+    std::cout << name << ": QPS = " << QPS << ", average cmps = " << cmps;
+    if (GT.size() > 0) std::cout << ", " << k << "@" << k << " recall = " << recall(R);
+    std::cout << std::endl;
+  };
+
+  double QPS, cmps;
+  auto separate = search<Point>(G, Points, Query_Points, QP, rounds, QPS, cmps);
+  report("separate", QPS, cmps, separate);
+  double base_QPS = QPS;
+
+  node_store<T, Point, unsigned int> S(Points, G);
+  auto SG = S.graph();
+  auto SP = S.points();
+  auto fused = search<Point>(SG, SP, Query_Points, QP, rounds, QPS, cmps);
+  report("node store", QPS, cmps, fused);
+  size_t same = 0;
+  for (size_t i = 0; i < fused.size(); i++) 
+    same += std::equal(fused[i].begin(), fused[i].end(), separate[i].begin(),
+                       separate[i].end());
+  std::cout << "QPS x" << QPS / base_QPS << ", " << same << " of "
+            << fused.size() << " queries with identical results" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  commandLine P(argc, argv,
+                "[-graph_path <g>] [-base_path <b>] [-query_path <q>] "
+                "[-gt_path <gt>] [-data_type <d>] [-dist_func <df>] "
+                "[-k <k>] [-L <L>] [-rounds <r>]");
+
+  char* gFile = P.getOptionValue("-graph_path");
+  char* bFile = P.getOptionValue("-base_path");
+  char* qFile = P.getOptionValue("-query_path");
+  char* cFile = P.getOptionValue("-gt_path");
+  char* vectype = P.getOptionValue("-data_type");
+  char* dfc = P.getOptionValue("-dist_func");
+  long k = P.getOptionIntValue("-k", 10);
+  long L = P.getOptionIntValue("-L", 50);
+  int rounds = P.getOptionIntValue("-rounds", 3);
+  if (gFile == NULL || bFile == NULL || qFile == NULL || vectype == NULL ||
+      dfc == NULL || k <= 0 || L < k || rounds < 1)
+    P.badArgument();
+
+  std::string tp = std::string(vectype);
+  std::string df = std::string(dfc);
+  if (df != "Euclidian" && df != "mips") {
+    std::cout << "Error: specify distance type Euclidian or mips" << std::endl;
+    abort();
+  }
+  bool l2 = (df == "Euclidian");
+  if (tp == "float") {
+    if (l2)
+      bench<Euclidian_Point<float>, float>(gFile, bFile, qFile, cFile, k, L, rounds);
+    else
+      bench<Mips_Point<float>, float>(gFile, bFile, qFile, cFile, k, L, rounds);
+  } else if (tp == "uint8") {
+    if (l2)
+      bench<Euclidian_Point<uint8_t>, uint8_t>(gFile, bFile, qFile, cFile, k, L, rounds);
+    else
+      bench<Mips_Point<uint8_t>, uint8_t>(gFile, bFile, qFile, cFile, k, L, rounds);
+  } else if (tp == "int8") {
+    if (l2)
+      bench<Euclidian_Point<int8_t>, int8_t>(gFile, bFile, qFile, cFile, k, L, rounds);
+    else
+      bench<Mips_Point<int8_t>, int8_t>(gFile, bFile, qFile, cFile, k, L, rounds);
+  } else {
+    std::cout << "Error: data type not specified correctly, specify int8, "
+                 "uint8, or float"
+              << std::endl;
+    abort();
+  }
+  return 0;
+}
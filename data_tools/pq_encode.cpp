@@ -0,0 +1,130 @@
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "parlay/internal/get_time.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "utils/beamSearch.h"
+#include "utils/euclidian_point.h"
+#include "utils/graph.h"
+#include "utils/mips_point.h"
+#include "utils/point_range.h"
+#include "utils/pq_point.h"
+#include "utils/stats.h"
+
+// Trains a product quantizer with -M subspaces on a base file and writes
+// the codebooks and codes (see algorithms/utils/pq_point.h), or reads them
+// from -pq_path.  Given a graph, queries and ground truth it then compares
+// the full precision search at beam width -L with searches that traverse
+// the PQ codes and re-rank the closest k, 2k, ... L entries of the beam.
+
+template <typename Point, typename T>
+void run(char* bFile, char* pqFile, char* oFile, unsigned M, size_t train,
+         int iters, char* gFile, char* qFile, char* cFile, long k, long L) {
+  using PR = PointRange<T, Point>;
+  PR Points(bFile);
+  parlay::internal::timer t("pq", false);
+  t.start();
+  PQPointRange<Point> PQ = pqFile != NULL
+                               ? PQPointRange<Point>(pqFile)
+                               : PQPointRange<Point>(Points, M, train, iters);
+  if (pqFile == NULL)
+    std::cout << "Encoded " << Points.size() << " points in " << t.next_time()
+              << " seconds" << std::endl;
+  if (PQ.size() != Points.size()) {
+    std::cout << "ERROR: product quantizer has " << PQ.size()
+              << " points, base file has " << Points.size() << std::endl;
+    abort();
+  }
+  if (oFile != NULL) PQ.save(oFile);
+  if (gFile == NULL || qFile == NULL || cFile == NULL) return;
+
+  Graph<unsigned int> G(gFile);
+  PR Query_Points(qFile);
+  groundTruth<unsigned int> GT(cFile);
+  QueryParams QP(k, L, 1.35, (long)G.size(), G.max_degree());
+  parlay::sequence<unsigned int> start = {0};
+
+  auto report = [&](std::string name, auto&& search) {
+    stats<unsigned int> QueryStats(Query_Points.size());
+    search(QueryStats);
+    QueryStats.clear();
+    t.start();
+    parlay::sequence<parlay::sequence<unsigned int>> R = search(QueryStats);
+    double QPS = Query_Points.size() / t.next_time();
+    size_t correct = 0;
+    for (size_t i = 0; i < R.size(); i++) {
+      std::set<unsigned int> reported(R[i].begin(), R[i].end());
+      for (long j = 0; j < k; j++) correct += reported.count(GT.coordinates(i, j));
+    }
+    std::cout << name << ": " << k << "@" << k << " recall = "
+              << (double)correct / (k * R.size()) << ", QPS = " << QPS
+              << ", average cmps = " << QueryStats.dist_stats()[0] << std::endl;
+  };
+  report("full precision", [&](stats<unsigned int>& S) {
+    return searchAll<Point, PR, unsigned int>(Query_Points, G, Points, S, start, QP);
+  });
+  for (long rerank = k; rerank <= L; rerank *= 2) {
+    QP.rerank_k = rerank;
+    report("PQ, re-rank " + std::to_string(rerank), [&](stats<unsigned int>& S) {
+      return searchAllReranked<Point, PR, PQPointRange<Point>, unsigned int>(
+          Query_Points, G, Points, PQ, S, start, QP);
+    });
+  }
+}
+
+int main(int argc, char* argv[]) {
+  commandLine P(argc, argv,
+                "[-base_path <b>] [-data_type <d>] [-dist_func <df>] [-M <m>] "
+                "[-train_size <t>] [-iters <i>] [-pq_outfile <o>] "
+                "[-pq_path <p>] [-graph_path <g>] [-query_path <q>] "
+                "[-gt_path <gt>] [-k <k>] [-L <L>]");
+
+  char* bFile = P.getOptionValue("-base_path");
+  char* vectype = P.getOptionValue("-data_type");
+  char* dfc = P.getOptionValue("-dist_func");
+  char* oFile = P.getOptionValue("-pq_outfile");
+  char* pqFile = P.getOptionValue("-pq_path");
+  char* gFile = P.getOptionValue("-graph_path");
+  char* qFile = P.getOptionValue("-query_path");
+  char* cFile = P.getOptionValue("-gt_path");
+  long M = P.getOptionIntValue("-M", 32);
+  long train = P.getOptionLongValue("-train_size", 100000);
+  int iters = P.getOptionIntValue("-iters", 10);
+  long k = P.getOptionIntValue("-k", 10);
+  long L = P.getOptionIntValue("-L", 100);
+  if (bFile == NULL || vectype == NULL || dfc == NULL || M <= 0 ||
+      train <= 0 || iters < 0 || k <= 0 || L < k)
+    P.badArgument();
+
+  std::string tp = std::string(vectype);
+  std::string df = std::string(dfc);
+  if (df != "Euclidian" && df != "mips") {
+    std::cout << "Error: specify distance type Euclidian or mips" << std::endl;
+    abort();
+  }
+  bool l2 = (df == "Euclidian");
+  if (tp == "float") {
+    if (l2)
+      run<Euclidian_Point<float>, float>(bFile, pqFile, oFile, M, train, iters, gFile, qFile, cFile, k, L);
+    else
+      run<Mips_Point<float>, float>(bFile, pqFile, oFile, M, train, iters, gFile, qFile, cFile, k, L);
+  } else if (tp == "uint8") {
+    if (l2)
+      run<Euclidian_Point<uint8_t>, uint8_t>(bFile, pqFile, oFile, M, train, iters, gFile, qFile, cFile, k, L);
+    else
+      run<Mips_Point<uint8_t>, uint8_t>(bFile, pqFile, oFile, M, train, iters, gFile, qFile, cFile, k, L);
+  } else if (tp == "int8") {
+    if (l2)
+      run<Euclidian_Point<int8_t>, int8_t>(bFile, pqFile, oFile, M, train, iters, gFile, qFile, cFile, k, L);
+    else
+      run<Mips_Point<int8_t>, int8_t>(bFile, pqFile, oFile, M, train, iters, gFile, qFile, cFile, k, L);
+  } else {
+    std::cout << "Error: data type not specified correctly, specify int8, "
+                 "uint8, or float"
+              << std::endl;
+    abort();
+  }
+  return 0;
+}
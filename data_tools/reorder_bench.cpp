@@ -0,0 +1,126 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "parlay/internal/get_time.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "utils/beamSearch.h"
+#include "utils/check_nn_recall.h"
+#include "utils/euclidian_point.h"
+#include "utils/graph.h"
+#include "utils/mips_point.h"
+#include "utils/point_range.h"
+#include "utils/reorder.h"
+
+// Query throughput of a built graph in its original vertex order and after
+// each of the given reorderings, searched from vertex 0 with beam width -L.
+// Results of the reordered graphs are translated back to the original ids,
+// so the recall of every row should match the original one.  Each
+// configuration is searched -rounds times and the best throughput is kept.
+
+template <typename Point, typename PointRange>
+nn_result best_of(Graph<unsigned int>& G, PointRange& Points,
+                  PointRange& Query_Points, groundTruth<unsigned int>& GT,
+                  long k, QueryParams& QP, int rounds,
+                  const parlay::sequence<unsigned int>& id_map) {
+  nn_result best = checkRecall<Point, PointRange, unsigned int>(
+      G, Points, Query_Points, GT, false, 0, k, QP, id_map);
+  for (int r = 1; r < rounds; r++) {
+    nn_result N = checkRecall<Point, PointRange, unsigned int>(
+        G, Points, Query_Points, GT, false, 0, k, QP, id_map);
+    if (N.QPS > best.QPS) best = N;
+  }
+  return best;
+}
+
+template <typename Point, typename PointRange>
+void bench(char* gFile, char* bFile, char* qFile, char* cFile,
+           std::string orders, long k, long L, int rounds) {
+  Graph<unsigned int> G(gFile);
+  PointRange Points(bFile);
+  PointRange Query_Points(qFile);
+  groundTruth<unsigned int> GT(cFile);
+  QueryParams QP(k, L, 1.35, (long)G.size(), G.max_degree());
+
+  nn_result base =
+      best_of<Point>(G, Points, Query_Points, GT, k, QP, rounds, {});
+  std::cout << "original: ";
+  base.print();
+
+  std::stringstream ss(orders);
+  std::string method;
+  while (std::getline(ss, method, ',')) {
+    parlay::internal::timer t("reorder", false);
+    t.start();
+    parlay::sequence<unsigned int> order =
+        vertex_order<unsigned int>(G, method, 0);
+    double order_time = t.next_time();
+    Graph<unsigned int> R = G.permute(order);
+    PointRange Reordered = Points.permute(order);
+    nn_result N = best_of<Point>(R, Reordered, Query_Points, GT, k, QP,
+                                 rounds, order);
+    std::cout << method << " (ordered in " << order_time
+              << "s, QPS x" << N.QPS / base.QPS << "): ";
+    N.print();
+  }
+}
+
+int main(int argc, char* argv[]) {
+  commandLine P(argc, argv,
+                "[-graph_path <g>] [-base_path <b>] [-query_path <q>] "
+                "[-gt_path <gt>] [-data_type <d>] [-dist_func <df>] "
+                "[-orders <bfs,rcm,gorder>] [-k <k>] [-L <L>] [-rounds <r>]");
+
+  char* gFile = P.getOptionValue("-graph_path");
+  char* bFile = P.getOptionValue("-base_path");
+  char* qFile = P.getOptionValue("-query_path");
+  char* cFile = P.getOptionValue("-gt_path");
+  char* vectype = P.getOptionValue("-data_type");
+  char* dfc = P.getOptionValue("-dist_func");
+  std::string orders = P.getOptionValue("-orders", "bfs,rcm,gorder");
+  long k = P.getOptionIntValue("-k", 10);
+  long L = P.getOptionIntValue("-L", 50);
+  int rounds = P.getOptionIntValue("-rounds", 3);
+  if (gFile == NULL || bFile == NULL || qFile == NULL || vectype == NULL ||
+      dfc == NULL || k <= 0 || L < k || rounds < 1)
+    P.badArgument();
+
+  std::string tp = std::string(vectype);
+  std::string df = std::string(dfc);
+  if (df != "Euclidian" && df != "mips") {
+    std::cout << "Error: specify distance type Euclidian or mips" << std::endl;
+    abort();
+  }
+  bool l2 = (df == "Euclidian");
+  if (tp == "float") {
+    if (l2)
+      bench<Euclidian_Point<float>, PointRange<float, Euclidian_Point<float>>>(
+          gFile, bFile, qFile, cFile, orders, k, L, rounds);
+    else
+      bench<Mips_Point<float>, PointRange<float, Mips_Point<float>>>(
+          gFile, bFile, qFile, cFile, orders, k, L, rounds);
+  } else if (tp == "uint8") {
+    if (l2)
+      bench<Euclidian_Point<uint8_t>,
+            PointRange<uint8_t, Euclidian_Point<uint8_t>>>(
+          gFile, bFile, qFile, cFile, orders, k, L, rounds);
+    else
+      bench<Mips_Point<uint8_t>, PointRange<uint8_t, Mips_Point<uint8_t>>>(
+          gFile, bFile, qFile, cFile, orders, k, L, rounds);
+  } else if (tp == "int8") {
+    if (l2)
+      bench<Euclidian_Point<int8_t>,
+            PointRange<int8_t, Euclidian_Point<int8_t>>>(
+          gFile, bFile, qFile, cFile, orders, k, L, rounds);
+    else
+      bench<Mips_Point<int8_t>, PointRange<int8_t, Mips_Point<int8_t>>>(
+          gFile, bFile, qFile, cFile, orders, k, L, rounds);
+  } else {
+    std::cout << "Error: data type not specified correctly, specify int8, "
+                 "uint8, or float"
+              << std::endl;
+    abort();
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <string>
+
+#include "parlay/internal/get_time.h"
+#include "parlay/parallel.h"
+#include "parlay/primitives.h"
+#include "utils/euclidian_point.h"
+#include "utils/graph.h"
+#include "utils/point_range.h"
+#include "utils/reorder.h"
+
+// Renumbers the vertices of a built graph in bfs, rcm or gorder order (see
+// algorithms/utils/reorder.h), and writes the graph and its base file in the
+// new order together with an id map from the new ids to the original ones.
+// The order starts from the start point saved with the graph unless -start
+// gives another vertex to start it from.  The saved start point carries
+// over in its new id, which is 0 unless -start was given.  Pass the map to
+// neighborsTime with -id_map_path to report results in the original ids.
+
+template <typename T>
+void reorder(char* gFile, char* bFile, std::string method, long start,
+             char* ogFile, char* obFile, char* mFile, bool padded) {
+  Graph<unsigned int> G(gFile);
+  PointRange<T, Euclidian_Point<T>> Points(bFile);
+  if (Points.size() != G.size()) {
+    std::cout << "ERROR: graph has " << G.size() << " points but base file has "
+              << Points.size() << std::endl;
+    abort();
+  }
+
+  if (start < 0) start = G.start_point();
+  if ((size_t)start >= G.size()) {
+    std::cout << "ERROR: start vertex " << start << " is not below the "
+              << G.size() << " points of the graph" << std::endl;
+    abort();
+  }
+
+  parlay::internal::timer t("reorder", false);
+  t.start();
+  parlay::sequence<unsigned int> order = vertex_order(G, method, (unsigned int)start);
+  std::cout << "Computed " << method << " order in " << t.next_time()
+            << " seconds" << std::endl;
+
+  Graph<unsigned int> R = G.permute(order);
+  if (padded)
+    R.save_padded(ogFile);
+  else
+    R.save(ogFile);
+  Points.permute(order).save(obFile);
+  write_id_map(mFile, order);
+}
+
+int main(int argc, char* argv[]) {
+  commandLine P(argc, argv,
+                "[-graph_path <g>] [-base_path <b>] [-data_type <d>] "
+                "[-order <bfs|rcm|gorder>] [-start <s>] [-graph_outfile <o>] "
+                "[-base_outfile <ob>] [-id_map_outfile <m>] [-format <f>]");
+
+  char* gFile = P.getOptionValue("-graph_path");
+  char* bFile = P.getOptionValue("-base_path");
+  char* vectype = P.getOptionValue("-data_type");
+  char* ogFile = P.getOptionValue("-graph_outfile");
+  char* obFile = P.getOptionValue("-base_outfile");
+  char* mFile = P.getOptionValue("-id_map_outfile");
+  std::string method = P.getOptionValue("-order", "bfs");
+  long start = P.getOptionLongValue("-start", -1);
+  std::string format = P.getOptionValue("-format", "compact");
+  if (gFile == NULL || bFile == NULL || vectype == NULL || ogFile == NULL ||
+      obFile == NULL || mFile == NULL)
+    P.badArgument();
+  if (format != "padded" && format != "compact") {
+    std::cout << "Error: invalid graph format: specify padded or compact"
+              << std::endl;
+    abort();
+  }
+
+  std::string tp = std::string(vectype);
+  bool padded = (format == "padded");
+  if (tp == "float")
+    reorder<float>(gFile, bFile, method, start, ogFile, obFile, mFile, padded);
+  else if (tp == "uint8")
+    reorder<uint8_t>(gFile, bFile, method, start, ogFile, obFile, mFile,
+                     padded);
+  else if (tp == "int8")
+    reorder<int8_t>(gFile, bFile, method, start, ogFile, obFile, mFile,
+                    padded);
+  else {
+    std::cout << "Error: data type not specified correctly, specify int8, "
+                 "uint8, or float"
+              << std::endl;
+    abort();
+  }
+  return 0;
+}
@@ -3,6 +3,7 @@
 #include "parlay/parallel.h"
 #include "parlay/primitives.h"
 #include "parlay/io.h"
+#include "utils/half.h"
 
 // convert from .bvec file to .u8bin file
 
@@ -35,6 +36,25 @@ auto convert_fourbyte(const char* infile, const char* outfile) {
   parlay::chars_to_file(strout, outfile);
 }
 
+// from a .fvecs file, rounding each coordinate to 16 bits
+template <typename H>
+auto convert_half(const char* infile, const char* outfile) {
+  auto str = parlay::chars_from_file(infile);
+  int dims = *((int *) str.data());
+  int n = str.size()/(4*dims+4);
+  std::cout << "n = " << n << " d = " << dims << std::endl;
+  auto vects = parlay::tabulate(n, [&] (int i) {
+		     const float* v = (const float*) (str.data() + 4 + i * (4 + 4*dims));
+		     parlay::sequence<char> out(2*dims);
+		     for (int j = 0; j < dims; j++) ((H*) out.data())[j] = H(v[j]);
+		     return out;});
+  parlay::sequence<char> head(8);
+  *((int *) head.data()) = n;
+  *(((int *) head.data()) + 1) = dims;
+  auto strout = parlay::append(head, parlay::flatten(vects));
+  parlay::chars_to_file(strout, outfile);
+}
+
 int main(int argc, char* argv[]) {
   if (argc != 4) {
     std::cout << "usage: vec_to_bin type <infile> <outfile>" << std::endl;
@@ -43,8 +63,10 @@ int main(int argc, char* argv[]) {
   std::string tp = std::string(argv[1]);
   if(tp == "uint8") convert_onebyte(argv[2], argv[3]);
   else if(tp == "float" | tp == "int") convert_fourbyte(argv[2], argv[3]);
+  else if(tp == "fp16") convert_half<float16>(argv[2], argv[3]);
+  else if(tp == "bf16") convert_half<bfloat16>(argv[2], argv[3]);
   else{
-    std::cout << "invalid type: specify uint8, float, or int" << std::endl;
+    std::cout << "invalid type: specify uint8, float, int, fp16 or bf16" << std::endl;
     abort();
   }
   return 0;
@@ -29,6 +29,8 @@
 #include "../algorithms/utils/graph.h"
 #include "../algorithms/utils/euclidian_point.h"
 #include "../algorithms/utils/mips_point.h"
+#include "../algorithms/utils/hamming_point.h"
+#include "../algorithms/utils/cosine_point.h"
 #include "../algorithms/utils/stats.h"
 
 
@@ -75,6 +77,22 @@ template void build_vamana_index<uint8_t, Euclidian_Point<uint8_t>>(std::string
 template void build_vamana_index<uint8_t, Mips_Point<uint8_t>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
                                           float, bool);
 
+template void build_vamana_index<float16, Euclidian_Point<float16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                          float, bool);
+template void build_vamana_index<float16, Mips_Point<float16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                          float, bool);
+
+template void build_vamana_index<bfloat16, Euclidian_Point<bfloat16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                           float, bool);
+template void build_vamana_index<bfloat16, Mips_Point<bfloat16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                           float, bool);
+
+template void build_vamana_index<uint8_t, Hamming_Point>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                          float, bool);
+
+template void build_vamana_index<float, Cosine_Point<float>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                        float, bool);
+
 
 
 template <typename T, typename Point>
@@ -120,6 +138,22 @@ template void build_hcnng_index<uint8_t, Euclidian_Point<uint8_t>>(std::string ,
 template void build_hcnng_index<uint8_t, Mips_Point<uint8_t>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
                                           uint32_t);
 
+template void build_hcnng_index<float16, Euclidian_Point<float16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                          uint32_t);
+template void build_hcnng_index<float16, Mips_Point<float16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                          uint32_t);
+
+template void build_hcnng_index<bfloat16, Euclidian_Point<bfloat16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                           uint32_t);
+template void build_hcnng_index<bfloat16, Mips_Point<bfloat16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                           uint32_t);
+
+template void build_hcnng_index<uint8_t, Hamming_Point>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                          uint32_t);
+
+template void build_hcnng_index<float, Cosine_Point<float>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                        uint32_t);
+
 
 template <typename T, typename Point>
 void build_pynndescent_index(std::string metric, std::string &vector_bin_path,
@@ -162,4 +196,20 @@ template void build_pynndescent_index<int8_t, Mips_Point<int8_t>>(std::string ,
 template void build_pynndescent_index<uint8_t, Euclidian_Point<uint8_t>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
                                           uint32_t, double, double);
 template void build_pynndescent_index<uint8_t, Mips_Point<uint8_t>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
-                                          uint32_t, double, double);
\ No newline at end of file
+                                          uint32_t, double, double);
+
+template void build_pynndescent_index<float16, Euclidian_Point<float16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                          uint32_t, double, double);
+template void build_pynndescent_index<float16, Mips_Point<float16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                          uint32_t, double, double);
+
+template void build_pynndescent_index<bfloat16, Euclidian_Point<bfloat16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                           uint32_t, double, double);
+template void build_pynndescent_index<bfloat16, Mips_Point<bfloat16>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                           uint32_t, double, double);
+
+template void build_pynndescent_index<uint8_t, Hamming_Point>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                          uint32_t, double, double);
+
+template void build_pynndescent_index<float, Cosine_Point<float>>(std::string , std::string &, std::string &, uint32_t, uint32_t,
+                                        uint32_t, double, double);
@@ -27,13 +27,16 @@
 #include "../algorithms/utils/graph.h"
 #include "../algorithms/utils/euclidian_point.h"
 #include "../algorithms/utils/mips_point.h"
+#include "../algorithms/utils/cosine_point.h"
 #include "../algorithms/utils/stats.h"
 #include "../algorithms/utils/beamSearch.h"
+#include "../algorithms/utils/pq_point.h"
 #include "pybind11/numpy.h"
 
 #include "parlay/parallel.h"
 #include "parlay/primitives.h"
 
+#include <limits>
 #include <stdio.h>
 
 namespace py = pybind11;
@@ -43,6 +46,10 @@ template<typename T, typename Point>
 struct GraphIndex{
     Graph<unsigned int> G;
     PointRange<T, Point> Points;
+    // if loaded, searches traverse the product quantized points and
+    // re-rank with Points
+    PQPointRange<Point> PQ;
+    bool quantized = false;
     
 
     GraphIndex(std::string &data_path, std::string &index_path, size_t num_points, size_t dimensions){
@@ -52,10 +59,44 @@ struct GraphIndex{
         assert(dimensions == Points.dimension());
     }
 
+    void load_pq(std::string &pq_path){
+        PQ = PQPointRange<Point>(pq_path.data());
+        assert(PQ.size() == Points.size());
+        quantized = true;
+    }
+
+    // writes the k nearest neighbors of q found with QP and their distances;
+    // a search that finds fewer pads them with -1 and the largest float
+    void search(Point q, QueryParams &QP, unsigned int *ids, float *dists){
+        // the start point saved with the graph, 0 unless Vamana chose it
+        unsigned int start = G.start_point();
+        if(quantized){
+            auto &ctx = local_search_context<unsigned int, float>();
+            auto [pairElts, dist_cmps] = beam_search(PQ.query(q), G, PQ,
+                parlay::make_slice(&start, &start + 1), QP, ctx);
+            auto exact = rerank<Point, PointRange<T, Point>, unsigned int>(q, Points, pairElts.first,
+                QP.k, QP.rerank_k);
+            for(int j=0; j<QP.k; j++){
+                ids[j] = j < exact.size() ? exact[j].first : -1;
+                dists[j] = j < exact.size() ? exact[j].second : std::numeric_limits<float>::max();
+            }
+            return;
+        }
+        auto &ctx = local_search_context<unsigned int, typename Point::distanceType>();
+        auto [pairElts, dist_cmps] = beam_search<Point, PointRange<T, Point>, unsigned int>(q, G, Points,
+            parlay::make_slice(&start, &start + 1), QP, ctx);
+        auto [frontier, visited] = pairElts;
+        for(int j=0; j<QP.k; j++){
+            ids[j] = j < frontier.size() ? frontier[j].first : -1;
+            dists[j] = j < frontier.size() ? frontier[j].second : std::numeric_limits<float>::max();
+        }
+    }
+
     NeighborsAndDistances batch_search(py::array_t<T, py::array::c_style | py::array::forcecast> &queries, uint64_t num_queries, uint64_t knn,
-                        uint64_t beam_width, int64_t visit_limit = -1){
+                        uint64_t beam_width, int64_t visit_limit = -1, int64_t rerank_k = 0){
         if(visit_limit == -1) visit_limit = G.size();
         QueryParams QP(knn, beam_width, 1.35, visit_limit, G.max_degree());
+        QP.rerank_k = rerank_k;
 
         py::array_t<unsigned int> ids({num_queries, knn});
         py::array_t<float> dists({num_queries, knn});
@@ -66,34 +107,29 @@ struct GraphIndex{
 
 
         parlay::parallel_for(0, num_queries, [&] (size_t i){
-            Point q = Point(queries.data(i), Points.dimension(), Points.aligned_dimension(), i);
-            auto [pairElts, dist_cmps] = beam_search<Point, PointRange<T, Point>, unsigned int>(q, G, Points, 0, QP);
-            auto [frontier, visited] = pairElts;
-            parlay::sequence<unsigned int> point_ids;
-            parlay::sequence<float> point_distances;
-            for(int j=0; j<knn; j++){
-                ids.mutable_data(i)[j] = frontier[j].first;
-                dists.mutable_data(i)[j] = frontier[j].second;
+            if constexpr (point_normalizes<Point>::value) {
+                // normalized like the points were when they were read
+                std::vector<T> v(queries.data(i), queries.data(i) + Points.dimension());
+                Point::normalize(v.data(), v.size());
+                Point q = Point(v.data(), Points.dimension(), Points.aligned_dimension(), i);
+                search(q, QP, ids.mutable_data(i), dists.mutable_data(i));
+            } else {
+                Point q = Point(queries.data(i), Points.dimension(), Points.aligned_dimension(), i);
+                search(q, QP, ids.mutable_data(i), dists.mutable_data(i));
             }
         });
         return std::make_pair(std::move(ids), std::move(dists));
     }
 
     NeighborsAndDistances batch_search_from_string(std::string &queries, uint64_t num_queries, uint64_t knn,
-                                    uint64_t beam_width){
+                                    uint64_t beam_width, int64_t rerank_k = 0){
         QueryParams QP(knn, beam_width, 1.35, G.size(), G.max_degree());
+        QP.rerank_k = rerank_k;
         PointRange<T, Point> QueryPoints = PointRange<T, Point>(queries.data());
         py::array_t<unsigned int> ids({num_queries, knn});
         py::array_t<float> dists({num_queries, knn});
         parlay::parallel_for(0, num_queries, [&] (size_t i){
-            auto [pairElts, dist_cmps] = beam_search<Point, PointRange<T, Point>, unsigned int>(QueryPoints[i], G, Points, (unsigned int) 0, QP);
-            auto [frontier, visited] = pairElts;
-            parlay::sequence<unsigned int> point_ids;
-            parlay::sequence<float> point_distances;
-            for(int j=0; j<knn; j++){
-                ids.mutable_data(i)[j] = frontier[j].first;
-                dists.mutable_data(i)[j] = frontier[j].second;
-            }
+            search(QueryPoints[i], QP, ids.mutable_data(i), dists.mutable_data(i));
         });
         return std::make_pair(std::move(ids), std::move(dists));
     }
@@ -54,6 +54,10 @@ const Variant UInt8MipsVariant{"build_vamana_uint8_mips_index", "UInt8MipsIndex"
 const Variant Int8EuclidianVariant{"build_vamana_int8_euclidian_index", "Int8EuclidianIndex"};
 const Variant Int8MipsVariant{"build_vamana_int8_mips_index", "Int8MipsIndex"};
 
+const Variant UInt8HammingVariant{"build_vamana_uint8_hamming_index", "UInt8HammingIndex"};
+
+const Variant FloatCosineVariant{"build_vamana_float_cosine_index", "FloatCosineIndex"};
+
 template <typename T, typename Point> inline void add_variant(py::module_ &m, const Variant &variant)
 {
 
@@ -64,15 +68,32 @@ template <typename T, typename Point> inline void add_variant(py::module_ &m, co
         .def(py::init<std::string &, std::string &, size_t, size_t>(),
              "index_path"_a, "data_path"_a, "num_points"_a, "dimensions"_a) //maybe these last two are unnecessary?
         //do we want to add options like visited limit, or leave those as defaults?
+        .def("load_pq", &GraphIndex<T, Point>::load_pq, "pq_path"_a)
         .def("batch_search", &GraphIndex<T, Point>::batch_search, "queries"_a, "num_queries"_a, "knn"_a,
-             "beam_width"_a, "visit_limit"_a)
+             "beam_width"_a, "visit_limit"_a, "rerank_k"_a = 0)
         .def("batch_search_from_string", &GraphIndex<T, Point>::batch_search_from_string, "queries"_a, "num_queries"_a, "knn"_a,
-             "beam_width"_a)
+             "beam_width"_a, "rerank_k"_a = 0)
         .def("check_recall", &GraphIndex<T, Point>::check_recall, "gFile"_a, "neighbors"_a, "k"_a);
 
    
 }
 
+const Variant Float16EuclidianVariant{"build_vamana_fp16_euclidian_index", ""};
+const Variant Float16MipsVariant{"build_vamana_fp16_mips_index", ""};
+
+const Variant BFloat16EuclidianVariant{"build_vamana_bf16_euclidian_index", ""};
+const Variant BFloat16MipsVariant{"build_vamana_bf16_mips_index", ""};
+
+// GraphIndex takes queries as numpy arrays of T, which pybind11 has no
+// type for when T is a 16 bit float, so these only bind the builder
+template <typename T, typename Point> inline void add_builder_variant(py::module_ &m, const Variant &variant)
+{
+
+    m.def(variant.builder_name.c_str(), build_vamana_index<T, Point>, "distance_metric"_a,
+          "data_file_path"_a, "index_output_path"_a, "graph_degree"_a, "beam_width"_a, "alpha"_a, "two_pass"_a);
+
+}
+
 const Variant FloatEuclidianHCNNGVariant{"build_hcnng_float_euclidian_index", "FloatEuclidianIndex"};
 const Variant FloatMipsHCNNGVariant{"build_hcnng_float_mips_index", "FloatMipsIndex"};
 
@@ -82,6 +103,16 @@ const Variant UInt8MipsHCNNGVariant{"build_hcnng_uint8_mips_index", "UInt8MipsIn
 const Variant Int8EuclidianHCNNGVariant{"build_hcnng_int8_euclidian_index", "Int8EuclidianIndex"};
 const Variant Int8MipsHCNNGVariant{"build_hcnng_int8_mips_index", "Int8MipsIndex"};
 
+const Variant UInt8HammingHCNNGVariant{"build_hcnng_uint8_hamming_index", "UInt8HammingIndex"};
+
+const Variant FloatCosineHCNNGVariant{"build_hcnng_float_cosine_index", "FloatCosineIndex"};
+
+const Variant Float16EuclidianHCNNGVariant{"build_hcnng_fp16_euclidian_index", ""};
+const Variant Float16MipsHCNNGVariant{"build_hcnng_fp16_mips_index", ""};
+
+const Variant BFloat16EuclidianHCNNGVariant{"build_hcnng_bf16_euclidian_index", ""};
+const Variant BFloat16MipsHCNNGVariant{"build_hcnng_bf16_mips_index", ""};
+
 template <typename T, typename Point> inline void add_hcnng_variant(py::module_ &m, const Variant &variant)
 {
 
@@ -100,6 +131,16 @@ const Variant UInt8MipspyNNVariant{"build_pynndescent_uint8_mips_index", "UInt8M
 const Variant Int8EuclidianpyNNVariant{"build_pynndescent_int8_euclidian_index", "Int8EuclidianIndex"};
 const Variant Int8MipspyNNVariant{"build_pynndescent_int8_mips_index", "Int8MipsIndex"};
 
+const Variant UInt8HammingpyNNVariant{"build_pynndescent_uint8_hamming_index", "UInt8HammingIndex"};
+
+const Variant FloatCosinepyNNVariant{"build_pynndescent_float_cosine_index", "FloatCosineIndex"};
+
+const Variant Float16EuclidianpyNNVariant{"build_pynndescent_fp16_euclidian_index", ""};
+const Variant Float16MipspyNNVariant{"build_pynndescent_fp16_mips_index", ""};
+
+const Variant BFloat16EuclidianpyNNVariant{"build_pynndescent_bf16_euclidian_index", ""};
+const Variant BFloat16MipspyNNVariant{"build_pynndescent_bf16_mips_index", ""};
+
 template <typename T, typename Point> inline void add_pynndescent_variant(py::module_ &m, const Variant &variant)
 {
 
@@ -134,6 +175,12 @@ PYBIND11_MODULE(_ParlayANNpy, m)
     add_variant<uint8_t, Mips_Point<uint8_t>>(m, UInt8MipsVariant);
     add_variant<int8_t, Euclidian_Point<int8_t>>(m, Int8EuclidianVariant);
     add_variant<int8_t, Mips_Point<int8_t>>(m, Int8MipsVariant);
+    add_variant<uint8_t, Hamming_Point>(m, UInt8HammingVariant);
+    add_variant<float, Cosine_Point<float>>(m, FloatCosineVariant);
+    add_builder_variant<float16, Euclidian_Point<float16>>(m, Float16EuclidianVariant);
+    add_builder_variant<float16, Mips_Point<float16>>(m, Float16MipsVariant);
+    add_builder_variant<bfloat16, Euclidian_Point<bfloat16>>(m, BFloat16EuclidianVariant);
+    add_builder_variant<bfloat16, Mips_Point<bfloat16>>(m, BFloat16MipsVariant);
 
     add_hcnng_variant<float, Euclidian_Point<float>>(m, FloatEuclidianHCNNGVariant);
     add_hcnng_variant<float, Mips_Point<float>>(m, FloatMipsHCNNGVariant);
@@ -141,6 +188,12 @@ PYBIND11_MODULE(_ParlayANNpy, m)
     add_hcnng_variant<uint8_t, Mips_Point<uint8_t>>(m, UInt8MipsHCNNGVariant);
     add_hcnng_variant<int8_t, Euclidian_Point<int8_t>>(m, Int8EuclidianHCNNGVariant);
     add_hcnng_variant<int8_t, Mips_Point<int8_t>>(m, Int8MipsHCNNGVariant);
+    add_hcnng_variant<uint8_t, Hamming_Point>(m, UInt8HammingHCNNGVariant);
+    add_hcnng_variant<float, Cosine_Point<float>>(m, FloatCosineHCNNGVariant);
+    add_hcnng_variant<float16, Euclidian_Point<float16>>(m, Float16EuclidianHCNNGVariant);
+    add_hcnng_variant<float16, Mips_Point<float16>>(m, Float16MipsHCNNGVariant);
+    add_hcnng_variant<bfloat16, Euclidian_Point<bfloat16>>(m, BFloat16EuclidianHCNNGVariant);
+    add_hcnng_variant<bfloat16, Mips_Point<bfloat16>>(m, BFloat16MipsHCNNGVariant);
 
     add_pynndescent_variant<float, Euclidian_Point<float>>(m, FloatEuclidianpyNNVariant);
     add_pynndescent_variant<float, Mips_Point<float>>(m, FloatMipspyNNVariant);
@@ -148,5 +201,11 @@ PYBIND11_MODULE(_ParlayANNpy, m)
     add_pynndescent_variant<uint8_t, Mips_Point<uint8_t>>(m, UInt8MipspyNNVariant);
     add_pynndescent_variant<int8_t, Euclidian_Point<int8_t>>(m, Int8EuclidianpyNNVariant);
     add_pynndescent_variant<int8_t, Mips_Point<int8_t>>(m, Int8MipspyNNVariant);
+    add_pynndescent_variant<uint8_t, Hamming_Point>(m, UInt8HammingpyNNVariant);
+    add_pynndescent_variant<float, Cosine_Point<float>>(m, FloatCosinepyNNVariant);
+    add_pynndescent_variant<float16, Euclidian_Point<float16>>(m, Float16EuclidianpyNNVariant);
+    add_pynndescent_variant<float16, Mips_Point<float16>>(m, Float16MipspyNNVariant);
+    add_pynndescent_variant<bfloat16, Euclidian_Point<bfloat16>>(m, BFloat16EuclidianpyNNVariant);
+    add_pynndescent_variant<bfloat16, Mips_Point<bfloat16>>(m, BFloat16MipspyNNVariant);
 
 }
\ No newline at end of file
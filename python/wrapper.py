@@ -8,6 +8,10 @@ def build_vamana_index(metric, dtype, data_dir, index_dir, R, L, alpha, two_pass
             build_vamana_int8_euclidian_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
         elif dtype == 'float':
             build_vamana_float_euclidian_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
+        elif dtype == 'fp16':
+            build_vamana_fp16_euclidian_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
+        elif dtype == 'bf16':
+            build_vamana_bf16_euclidian_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
         else:
             raise Exception('Invalid data type ' + dtype)
     elif metric == 'mips':
@@ -17,6 +21,20 @@ def build_vamana_index(metric, dtype, data_dir, index_dir, R, L, alpha, two_pass
             build_vamana_int8_mips_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
         elif dtype == 'float':
             build_vamana_float_mips_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
+        elif dtype == 'fp16':
+            build_vamana_fp16_mips_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
+        elif dtype == 'bf16':
+            build_vamana_bf16_mips_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
+        else:
+            raise Exception('Invalid data type ' + dtype)
+    elif metric == 'cosine':
+        if dtype == 'float':
+            build_vamana_float_cosine_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
+        else:
+            raise Exception('Invalid data type ' + dtype)
+    elif metric == 'hamming':
+        if dtype == 'uint8':
+            build_vamana_uint8_hamming_index(metric, data_dir, index_dir, R, L, alpha, two_pass)
         else:
             raise Exception('Invalid data type ' + dtype)
     else:
@@ -32,6 +50,10 @@ def build_hcnng_index(metric, dtype, data_dir, index_dir, mst_deg, num_clusters,
             build_hcnng_int8_euclidian_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
         elif dtype == 'float':
             build_hcnng_float_euclidian_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
+        elif dtype == 'fp16':
+            build_hcnng_fp16_euclidian_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
+        elif dtype == 'bf16':
+            build_hcnng_bf16_euclidian_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
         else:
             raise Exception('Invalid data type ' + dtype)
     elif metric == 'mips':
@@ -41,6 +63,20 @@ def build_hcnng_index(metric, dtype, data_dir, index_dir, mst_deg, num_clusters,
             build_hcnng_int8_mips_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
         elif dtype == 'float':
             build_hcnng_float_mips_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
+        elif dtype == 'fp16':
+            build_hcnng_fp16_mips_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
+        elif dtype == 'bf16':
+            build_hcnng_bf16_mips_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
+        else:
+            raise Exception('Invalid data type ' + dtype)
+    elif metric == 'cosine':
+        if dtype == 'float':
+            build_hcnng_float_cosine_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
+        else:
+            raise Exception('Invalid data type ' + dtype)
+    elif metric == 'hamming':
+        if dtype == 'uint8':
+            build_hcnng_uint8_hamming_index(metric, data_dir, index_dir, mst_deg, num_clusters, cluster_size)
         else:
             raise Exception('Invalid data type ' + dtype)
     else:
@@ -55,6 +91,10 @@ def build_pynndescent_index(metric, dtype, data_dir, index_dir, max_deg, num_clu
             build_pynndescent_int8_euclidian_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
         elif dtype == 'float':
             build_pynndescent_float_euclidian_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
+        elif dtype == 'fp16':
+            build_pynndescent_fp16_euclidian_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
+        elif dtype == 'bf16':
+            build_pynndescent_bf16_euclidian_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
         else:
             raise Exception('Invalid data type ' + dtype)
     elif metric == 'mips':
@@ -64,6 +104,20 @@ def build_pynndescent_index(metric, dtype, data_dir, index_dir, max_deg, num_clu
             build_pynndescent_int8_mips_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
         elif dtype == 'float':
             build_pynndescent_float_mips_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
+        elif dtype == 'fp16':
+            build_pynndescent_fp16_mips_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
+        elif dtype == 'bf16':
+            build_pynndescent_bf16_mips_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
+        else:
+            raise Exception('Invalid data type ' + dtype)
+    elif metric == 'cosine':
+        if dtype == 'float':
+            build_pynndescent_float_cosine_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
+        else:
+            raise Exception('Invalid data type ' + dtype)
+    elif metric == 'hamming':
+        if dtype == 'uint8':
+            build_pynndescent_uint8_hamming_index(metric, data_dir, index_dir, max_deg, num_clusters, cluster_size, alpha, delta)
         else:
             raise Exception('Invalid data type ' + dtype)
     else:
@@ -88,5 +142,15 @@ def load_index(metric, dtype, data_dir, index_dir, n, d):
             return FloatMipsIndex(data_dir, index_dir, n, d)
         else:
             raise Exception('Invalid data type')
+    elif metric == 'cosine':
+        if dtype == 'float':
+            return FloatCosineIndex(data_dir, index_dir, n, d)
+        else:
+            raise Exception('Invalid data type')
+    elif metric == 'hamming':
+        if dtype == 'uint8':
+            return UInt8HammingIndex(data_dir, index_dir, n, d)
+        else:
+            raise Exception('Invalid data type')
     else:
         raise Exception('Invalid metric')
\ No newline at end of file